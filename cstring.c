@@ -1,16 +1,87 @@
+// the library itself uses the member names, never their legacy macros
+#undef CSTR_LEGACY_MEMBERS
 #include "cstring.h"
 
+#include <math.h>
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CSTR_POSIX      1
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define CSTR_POSIX      0
+#endif
+
 #define ITR_END                 0xdeadbeef
 
 #define CSTR_PAD        1
-
+#define CSTR_MIN_CAP    15
+
+// bytes in the single block of a heap string with room for cap characters
+#define CSTR_BLOCK(cap) (sizeof(struct _cstr_) + (cap) + CSTR_PAD)
+
+// vectorized searching on x86-64 with GCC or Clang,
+// define CSTR_NO_SIMD to build only the portable versions
+#if !defined(CSTR_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define CSTR_SIMD       1
+#include <immintrin.h>
+#else
+#define CSTR_SIMD       0
+#endif
+
+// header and characters share a single allocation, val runs on
+// past the end of the struct for capacity + CSTR_PAD bytes
 struct _cstr_
 {
-    size_t size;
-    size_t allocator_size;
-    void * rend;
-    char * val;
-    void * end;
+    size_t   size;
+    size_t   capacity;  // characters val can hold before it must be reallocated
+    uint64_t hash;      // cached result of hash, 0 until computed and reset by every modifier
+    atomic_size_t refs; // other cstrings sharing this block, it is read only while not 0
+    char     val[];
+};
+
+// a cstring must have room for a header and a short string in its sso storage
+_Static_assert(sizeof(((cstring*)0)->sso) >= sizeof(struct _cstr_) + CSTR_SSO_CAPACITY + CSTR_PAD
+               && offsetof(struct _cstr_, val) == sizeof(struct _cstr_),
+               "CSTR_SSO_HEADER is too small for struct _cstr_");
+
+// needles shorter than this are searched with cstr_scan, longer ones with
+// Horspool until CSTR_PAT_TWO_WAY where the linear Two-Way search takes over
+#define CSTR_PAT_HORSPOOL   4
+#define CSTR_PAT_TWO_WAY    32
+
+// a compiled needle and the tables its search algorithm needs
+struct _cstr_pattern_
+{
+    size_t len;
+    size_t suffix;          // Two-Way critical factorization
+    size_t period;          // Two-Way period of the needle
+    bool   periodic;        // Two-Way needle is periodic around its factorization
+    size_t shift[256];      // distance to shift for the character under the needle's end
+    char   val[];
+};
+
+#define CSTR_AC_NONE    UINT32_MAX
+
+// Aho-Corasick automaton, every table but cls is indexed by state and
+// the root is state 0. Transitions already have the failure links folded
+// in so the scan never backtracks
+struct _cstr_automaton_
+{
+    size_t     states;
+    size_t     classes;     // distinct characters used by the needles, plus one for all others
+    size_t     count;       // number of needles
+    uint16_t   cls[256];    // character to column of delta
+    uint32_t * delta;       // states x classes transition table
+    uint32_t * first;       // first needle ending at the state or CSTR_AC_NONE
+    uint32_t * link;        // next state on the failure chain that ends a needle
+    uint32_t * next;        // next needle with the same characters, indexed by needle
+    size_t   * len;         // length of each needle
 };
 
 struct _base_iterator_
@@ -24,19 +95,15 @@ struct _base_iterator_
     const void      (*inc)  (base_iterator);
     const void      (*dec)  (base_iterator);
     const short     (*cat)  (base_iterator);
-
+    char   cell[];      // buf, a null terminated copy of the current element
 };
 
 /// ITERATOR Functions ///
 
 const void b_itr_set(base_iterator this, void * p)
 {
-    void * pz = malloc(this->data_size+1);
-    memset(pz,0,this->data_size+1);
-    memcpy(pz,p,this->data_size);
-    free(this->buf);
+    memcpy(this->buf,p,this->data_size);
     this->ptr = p;
-    this->buf = pz;
 }
 
 void * b_itr_ref(base_iterator this)
@@ -75,10 +142,39 @@ const base_iterator c_itr_ref(cstr_iterator this)
     return this->base;
 }
 
+// the members forward to the base iterator so they are called
+// on the cstr_iterator itself, E.G. itr->inc(itr)
+
+const void c_itr_set(cstr_iterator this, char * p)
+{
+    this->base->set(this->base, p);
+}
+
+char * c_itr_val(cstr_iterator this)
+{
+    return this->base->ref(this->base);
+}
+
+const void c_itr_inc(cstr_iterator this)
+{
+    this->base->inc(this->base);
+}
+
+const void c_itr_dec(cstr_iterator this)
+{
+    this->base->dec(this->base);
+}
+
+const short c_itr_cat(cstr_iterator this)
+{
+    return this->base->cat(this->base);
+}
+
 /// ITERATOR Allocator ///
 base_iterator b_itr(const short category, size_t data_size)
 {
-    base_iterator b = malloc(sizeof(struct _base_iterator_));
+    // the element copy lives in the same block, stepping never allocates
+    base_iterator b = malloc(sizeof(struct _base_iterator_) + data_size + 1);
 
     if(category < ITR_FORWARD || category > ITR_R_BI_DIRECTIONAL)
         b->category = ITR_BI_DIRECTIONAL;
@@ -86,8 +182,9 @@ base_iterator b_itr(const short category, size_t data_size)
         b->category = category;
 
     b->ptr = NULL;
-    b->buf = NULL;
+    b->buf = b->cell;
     b->data_size = data_size;
+    memset(b->cell, 0, data_size + 1);
 
     b->set = &b_itr_set;
     b->ref = &b_itr_ref;
@@ -105,250 +202,724 @@ cstr_iterator cstr_itr(const short category)
     citr->base = b_itr(category, sizeof(char));
 
     citr->ref = &c_itr_ref;
-    citr->set = (const void*)citr->base->set;
-    citr->val = (char*(*)(cstr_iterator))citr->base->ref;
-    citr->cat = (const short(*)(cstr_iterator))citr->base->cat;
-    citr->inc = (const void(*)(cstr_iterator))citr->base->inc;
-    citr->dec = (const void(*)(cstr_iterator))citr->base->dec;
+    citr->set = &c_itr_set;
+    citr->val = &c_itr_val;
+    citr->cat = &c_itr_cat;
+    citr->inc = &c_itr_inc;
+    citr->dec = &c_itr_dec;
 
     return citr;
 }
 
+const void delete_itr(cstr_iterator itr)
+{
+    if(itr == NULL || itr == (cstr_iterator)ITR_END)
+        return;
+    free(itr->base);
+    free(itr);
+}
 
-/// CSTR Allocator ///
-
-cstr new_cstr(const char * str);
-
-/// Modifiers ///
-
-const void cstr_add(cstring * this, const char * s);
-const void cstr_push_back(cstring * this, const char c);
-const void cstr_pop_back(cstring * this);
-const void cstr_assign(cstring * this, const char * s);
-const void cstr_insert(cstring * this, size_t pos, const char * s);
-const void cstr_erase(cstring * this, size_t pos, size_t len);
-const void cstr_swap(cstring * this, cstring * str_2);
 
+/// CSTR Allocator ///
 
-/// Element Access ///
-const char cstr_at(cstring * this, size_t pos);
-const char cstr_back(cstring * this);
-const char cstr_front(cstring * this);
+cstr new_cstr(const cstr_allocator * alloc, const char * str, size_t len);
+static cstr init_cstr(void * mem, size_t cap, const char * str, size_t len);
+static void * cstr_mem_alloc(const cstr_allocator * alloc, size_t size);
+static void * cstr_mem_realloc(const cstr_allocator * alloc, void * ptr, size_t old_size, size_t new_size);
+static void cstr_mem_free(const cstr_allocator * alloc, void * ptr, size_t size);
+static inline bool cstr_is_mapped(cstring * this);
+static inline bool cstr_is_readonly(cstring * this);
+static void cstr_release(cstring * this, cstr s);
+static bool cstr_detach(cstring * this, const char * str, size_t len, size_t cap);
 
 
-/// String Operartions ///
-const char * cstr_data(cstring * this);
-const size_t cstr_copy(cstring * this, char ** s, size_t pos, size_t len);
-const size_t cstr_find(cstring * this, const char * s, size_t * pos);
-const size_t cstr_find_first(cstring * this, const char * s, size_t pos);
-const size_t cstr_find_last(cstring * this, const char * s, size_t pos);
-const size_t cstr_find_first_not(cstring * this, const char * s, size_t pos);
-const size_t cstr_find_last_not(cstring * this, const char * s, size_t pos);
-const char * cstr_substr(cstring * this, size_t pos, size_t len);
-const bool   cstr_compare(cstring * this, const char * s);
+/// CSTRING Methods ///
 
+// shared by every cstring, each instance only carries a pointer to it
+static const cstring_ops cstr_ops =
+{
+    .append = &cstr_append,
+    .append_n = &cstr_append_n,
+    .append_int = &cstr_append_int,
+    .append_uint = &cstr_append_uint,
+    .append_double = &cstr_append_double,
+    .push_back = &cstr_push_back,
+    .pop_back = &cstr_pop_back,
+    .assign = &cstr_assign,
+    .assign_n = &cstr_assign_n,
+    .insert = &cstr_insert,
+    .insert_n = &cstr_insert_n,
+    .erase = &cstr_erase,
+    .swap = &cstr_swap,
+    .share = &cstr_share,
+    .at = &cstr_at,
+    .back = &cstr_back,
+    .front = &cstr_front,
+    .data = &cstr_data,
+    .copy = &cstr_copy,
+    .find = &cstr_find,
+    .find_n = &cstr_find_n,
+    .find_first_of = &cstr_find_first_of,
+    .find_last_of = &cstr_find_last_of,
+    .find_first_not_of = &cstr_find_first_not_of,
+    .find_last_not_of = &cstr_find_last_not_of,
+    .find_first_in = &cstr_find_first_in,
+    .find_last_in = &cstr_find_last_in,
+    .find_first_not_in = &cstr_find_first_not_in,
+    .find_last_not_in = &cstr_find_last_not_in,
+    .find_pattern = &cstr_find_pattern,
+    .find_all = &cstr_find_all,
+    .find_any = &cstr_find_any,
+    .split = &cstr_split_into,
+    .substr = &cstr_substr,
+    .compare = &cstr_compare,
+    .compare_n = &cstr_compare_n,
+    .view = &cstr_view_of,
+    .subview = &cstr_subview,
+    .append_view = &cstr_append_view,
+    .assign_view = &cstr_assign_view,
+    .insert_view = &cstr_insert_view,
+    .find_view = &cstr_find_view,
+    .compare_view = &cstr_compare_view,
+    .hash = &cstr_hash,
+    .to_int = &cstr_to_int,
+    .to_uint = &cstr_to_uint,
+    .to_double = &cstr_to_double,
+    .length = &cstr_length,
+    .max_size = &cstr_max_size,
+    .resize = &cstr_resize,
+    .clear = &cstr_clear,
+    .empty = &cstr_empty,
+    .shrink_to_fit = &cstr_shrink_to_fit,
+    .capacity = &cstr_capacity,
+    .reserve = &cstr_reserve,
+    .begin = &cstr_begin,
+    .rbegin = &cstr_rbegin,
+    .end = &cstr_end,
+    .rend = &cstr_rend,
+    .itr_begin = &cstr_itr_begin,
+    .itr_end = &cstr_itr_end,
+    .itr_rbegin = &cstr_itr_rbegin,
+    .itr_rend = &cstr_itr_rend,
+};
 
-/// Capacity ///
-const size_t cstr_len(cstring * this);
-const size_t cstr_max(cstring * this);
-const size_t cstr_resize(cstring * this, size_t nsize);
-const void   cstr_clear(cstring * this);
-const bool   cstr_empty(cstring * this);
-const void   cstr_shrink(cstring * this);
+// Points a new cstring at the shared member functions
+static inline void cstr_bind(cstring * cs)
+{
+    cs->ops = &cstr_ops;
+}
 
 
-/// Iterators ///
-cstr_iterator cstr_begin(cstring * this);
-cstr_iterator cstr_rbegin(cstring * this);
-cstr_iterator cstr_end(cstring * this);
-cstr_iterator cstr_rend(cstring * this);
+cstring * string(const char * str)
+{
+    if(str==NULL)
+        str = "";
+    return string_n(str, strlen(str));
+}
 
+cstring * string_n(const char * str, size_t len)
+{
+    return string_alloc(str, len, NULL);
+}
 
-cstring * string(const char * str)
+cstring * string_alloc(const char * str, size_t len, const cstr_allocator * alloc)
 {
-    cstring * cs = malloc(sizeof(struct _cstring_));
+    cstring * cs = cstr_mem_alloc(alloc, sizeof(struct _cstring_));
+    if(cs == NULL)
+        return NULL;
 
     if(str==NULL)
-        cs->str = new_cstr("");
+        len = 0;
+
+    // short strings live in the cstring itself and need no allocation
+    if(len <= CSTR_SSO_CAPACITY)
+        cs->str = init_cstr(cs->sso, CSTR_SSO_CAPACITY, str, len);
     else
-        cs->str = new_cstr(str);
-
-    cs->append = &cstr_add;
-    cs->push_back = &cstr_push_back;
-    cs->pop_back = &cstr_pop_back;
-    cs->assign = &cstr_assign;
-    cs->erase = &cstr_erase;
-    cs->insert = &cstr_insert;
-    cs->swap = &cstr_swap;
-    cs->at = &cstr_at;
-    cs->back = &cstr_back;
-    cs->front = &cstr_front;
-    cs->data = &cstr_data;
-    cs->copy = &cstr_copy;
-    cs->find = &cstr_find;
-    cs->find_first_of = &cstr_find_first;
-    cs->find_last_of = &cstr_find_last;
-    cs->find_first_not_of = &cstr_find_first_not;
-    cs->find_last_not_of = &cstr_find_last_not;
-    cs->substr = &cstr_substr;
-    cs->compare = &cstr_compare;
-    cs->length = &cstr_len;
-    cs->max_size = &cstr_max;
-    cs->resize = &cstr_resize;
-    cs->clear = &cstr_clear;
-    cs->empty = &cstr_empty;
-    cs->shrink_to_fit = &cstr_shrink;
-    cs->begin = &cstr_begin;
-    cs->rbegin = &cstr_rbegin;
-    cs->end = &cstr_end;
-    cs->rend = &cstr_rend;
+        cs->str = new_cstr(alloc, str, len);
+
+    if(cs->str == NULL)
+    {
+        cstr_mem_free(alloc, cs, sizeof(struct _cstring_));
+        return NULL;
+    }
+
+    cstr_bind(cs);
+    cs->alloc = alloc;
 
     return cs;
 }
 
-void  delete_string(cstring * this)
+// True while the string is held in the cstring's own sso storage
+static inline bool cstr_is_inline(cstring * this)
+{
+    return this->str == (cstr)this->sso;
+}
+
+const void delete_string(cstring * this)
 {
-    free(this->str);
-    free(this);
+    if(this == NULL)
+        return;
+    if(!cstr_is_inline(this))
+        cstr_release(this, this->str);
+    cstr_mem_free(this->alloc, this, sizeof(struct _cstring_));
     this = NULL;
 }
 
 /// CSTR Allocator ///
 
-cstr new_cstr(const char * str)
+// route every cstring allocation through its allocator, or the C library without one
+
+static void * cstr_mem_alloc(const cstr_allocator * alloc, size_t size)
+{
+    return alloc == NULL ? malloc(size) : alloc->alloc(alloc->ctx, size);
+}
+
+static void * cstr_mem_realloc(const cstr_allocator * alloc, void * ptr, size_t old_size, size_t new_size)
+{
+    return alloc == NULL ? realloc(ptr, new_size) : alloc->realloc(alloc->ctx, ptr, old_size, new_size);
+}
+
+static void cstr_mem_free(const cstr_allocator * alloc, void * ptr, size_t size)
+{
+    if(alloc == NULL)
+        free(ptr);
+    else
+        alloc->free(alloc->ctx, ptr, size);
+}
+
+cstr new_cstr(const cstr_allocator * alloc, const char * str, size_t len)
 {
-    cstr s = malloc(sizeof(struct _cstr_) + strlen(str) + CSTR_PAD);
+    return init_cstr(cstr_mem_alloc(alloc, CSTR_BLOCK(len)), len, str, len);
+}
 
-    s->size = strlen(str);
-    s->allocator_size = sizeof(struct _cstr_) + strlen(str) + CSTR_PAD;
-    s->val = malloc(strlen(str) + CSTR_PAD);
+// Sets up a cstr header and its characters in memory with room for 'cap' characters
+static cstr init_cstr(void * mem, size_t cap, const char * str, size_t len)
+{
+    cstr s = mem;
+    if(s == NULL)
+        return NULL;
 
-    memset(s->val,0, strlen(str) + CSTR_PAD);
-    memcpy(s->val, str, strlen(str));
+    s->size = len;
+    s->capacity = cap;
+    s->hash = 0;
+    atomic_init(&s->refs, 0);
 
-    s->rend = (void*)ITR_END;
-    s->end = (void*)ITR_END;
+    if(len)
+        memcpy(s->val, str, len);
+    s->val[len] = '\0';
 
     return s;
 }
 
+// Moves the string into storage that holds exactly 'cap' characters, strings
+// that fit go back into the sso storage and longer ones go to the heap.
+// Returns false and leaves the string untouched if the allocation fails
+static bool cstr_realloc(cstring * this, size_t cap)
+{
+    cstr s;
+
+    if(cstr_is_readonly(this))
+        return cstr_detach(this, this->str->val, this->str->size, cap);
 
-/// Modifiers ///
+    if(cap <= CSTR_SSO_CAPACITY)
+    {
+        if(!cstr_is_inline(this))
+        {
+            s = this->str;
+            this->str = init_cstr(this->sso, CSTR_SSO_CAPACITY, s->val, s->size);
+            this->str->hash = s->hash;
+            cstr_mem_free(this->alloc, s, CSTR_BLOCK(s->capacity));
+        }
+        return true;
+    }
+
+    if(cstr_is_inline(this))
+    {
+        s = cstr_mem_alloc(this->alloc, CSTR_BLOCK(cap));
+        if(s == NULL)
+            return false;
+        memcpy(s, this->str, CSTR_BLOCK(this->str->size));
+    }
+    else
+    {
+        s = cstr_mem_realloc(this->alloc, this->str, CSTR_BLOCK(this->str->capacity), CSTR_BLOCK(cap));
+        if(s == NULL)
+            return false;
+    }
+
+    s->capacity = cap;
+    this->str = s;
+    return true;
+}
 
-void cstr_append(cstring * this, const char * s)
+// Ensures the string can hold at least 'need' characters without reallocating.
+// Capacity grows geometrically so repeated appends are amortized O(1)
+static bool cstr_grow(cstring * this, size_t need)
 {
-    if(this == NULL)
-        return;
+    if(need <= this->str->capacity && !cstr_is_readonly(this))
+        return true;
 
-    size_t ns = this->str->size + strlen(s) + CSTR_PAD;
-    char * sz = malloc(ns);
+    size_t ncap = this->str->capacity < CSTR_MIN_CAP ? CSTR_MIN_CAP : this->str->capacity;
+    while(ncap < need)
+        ncap = ncap > (SIZE_MAX - sizeof(struct _cstr_) - CSTR_PAD) / 2 ? need : ncap * 2;
+
+    return cstr_realloc(this, ncap);
+}
 
-    memset(sz, 0, ns);
-    memcpy(sz, this->str->val, this->str->size);
-    memcpy(sz + this->str->size, s, strlen(s));
+/// CSTR Mapping ///
 
-    free(this->str);
+// A mapped string keeps its header at the end of a private page and maps the
+// file read only directly after it, so val is the file contents. The zero fill
+// past the end of the file, or the reserved page after it, terminates it
 
-    this->str = new_cstr(sz);
+// the hooks of a mapped cstring, they only ever see the cstring itself
+static void * cstr_std_alloc(void * ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
 
-    free(sz);
+static void * cstr_std_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
 }
 
-void cstr_push_back(cstring * this, const char c)
+static void cstr_std_free(void * ctx, void * ptr, size_t size)
 {
-    if(this == NULL)
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+// marks a cstring whose str is a file mapping
+static const cstr_allocator cstr_mapped = { &cstr_std_alloc, &cstr_std_realloc, &cstr_std_free, NULL };
+
+static inline bool cstr_is_mapped(cstring * this)
+{
+    return this->alloc == &cstr_mapped;
+}
+
+#if CSTR_POSIX
+static size_t cstr_page_size(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+// the whole region of a mapping holding len characters
+static size_t cstr_map_span(size_t len)
+{
+    size_t page = cstr_page_size();
+    return page + (len + CSTR_PAD + page - 1) / page * page;
+}
+#endif
+
+/// CSTR Sharing ///
+
+// Heap and mapped blocks can be shared by any number of cstrings, see
+// string_share. A shared block is never written, the first modifier to reach
+// it gives its cstring a private copy instead and drops its reference
+
+static inline bool cstr_is_shared(cstring * this)
+{
+    return atomic_load_explicit(&this->str->refs, memory_order_acquire) != 0;
+}
+
+// True if the block must be copied before it can be written
+static inline bool cstr_is_readonly(cstring * this)
+{
+    return cstr_is_mapped(this) || (!cstr_is_inline(this) && cstr_is_shared(this));
+}
+
+// The allocators of a and b free cstrings and blocks the same way
+static inline bool cstr_same_heap(const cstr_allocator * a, const cstr_allocator * b)
+{
+    return a == b || ((a == NULL || a == &cstr_mapped) && (b == NULL || b == &cstr_mapped));
+}
+
+// Drops this cstring's reference to block s, which is freed or unmapped by
+// whichever cstring lets go of it last
+static void cstr_release(cstring * this, cstr s)
+{
+    // the common unshared case needs no atomic read-modify-write
+    if(atomic_load_explicit(&s->refs, memory_order_acquire) != 0
+       && atomic_fetch_sub_explicit(&s->refs, 1, memory_order_acq_rel) != 0)
         return;
 
-    char s[2] = {c, '\0'};
-    cstr_append(this, s);
+    if(cstr_is_mapped(this))
+    {
+#if CSTR_POSIX
+        // the header sits just before the first page of the file
+        char * base = (char *)s->val - cstr_page_size();
+        munmap(base, cstr_map_span(s->capacity));
+#endif
+    }
+    else
+        cstr_mem_free(this->alloc, s, CSTR_BLOCK(s->capacity));
 }
 
-void cstr_pop_back(cstring * this)
+// Gives the cstring a private block of capacity cap holding the first len
+// characters of str, which may point into the old block, and releases the
+// old one. Returns false and changes nothing if the allocation fails
+static bool cstr_detach(cstring * this, const char * str, size_t len, size_t cap)
 {
-    if(this == NULL)
+    const cstr_allocator * alloc = cstr_is_mapped(this) ? NULL : this->alloc;
+    cstr old = this->str;
+    cstr s;
+
+    if(cap < len)
+        cap = len;
+    s = cap <= CSTR_SSO_CAPACITY ? init_cstr(this->sso, CSTR_SSO_CAPACITY, str, len)
+                                 : init_cstr(cstr_mem_alloc(alloc, CSTR_BLOCK(cap)), cap, str, len);
+    if(s == NULL)
+        return false;
+
+    cstr_release(this, old);
+    this->str = s;
+    this->alloc = alloc;
+    return true;
+}
+
+cstring * string_share(cstring * src)
+{
+    if(src == NULL)
+        return NULL;
+
+    // short strings are cheaper to copy than to share
+    if(cstr_is_inline(src))
+        return string_alloc(src->str->val, src->str->size, src->alloc);
+
+    cstring * cs = cstr_mem_alloc(src->alloc, sizeof(struct _cstring_));
+    if(cs == NULL)
+        return NULL;
+
+    atomic_fetch_add_explicit(&src->str->refs, 1, memory_order_relaxed);
+    cs->str = src->str;
+    cstr_bind(cs);
+    cs->alloc = src->alloc;
+    return cs;
+}
+
+const void cstr_share(cstring * this, cstring * src)
+{
+    if(this == NULL || src == NULL || this->str == src->str)
         return;
 
-    size_t ns = this->str->size;
-    char * sz = malloc(ns);
+    if(cstr_is_inline(src) || !cstr_same_heap(this->alloc, src->alloc))
+    {
+        cstr_assign_n(this, src->str->val, src->str->size);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&src->str->refs, 1, memory_order_relaxed);
+    if(!cstr_is_inline(this))
+        cstr_release(this, this->str);
+    this->str = src->str;
+    this->alloc = src->alloc;
+}
 
-    memset(sz, 0, ns);
-    memcpy(sz, this->str->val, this->str->size - 1);
+// Reads a whole file into an ordinary cstring
+static cstring * cstr_read_file(FILE * f)
+{
+    cstring * cs = string_n("", 0);
+    char buf[4096];
+    size_t n;
 
-    free(this->str);
+    while(cs != NULL && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        size_t size = cs->str->size;
+        cstr_append_n(cs, buf, n);
+        if(cs->str->size != size + n)
+        {
+            delete_string(cs);
+            cs = NULL;
+        }
+    }
 
-    this->str = new_cstr(sz);
+    if(cs != NULL && ferror(f))
+    {
+        delete_string(cs);
+        cs = NULL;
+    }
 
-    free(sz);
+    return cs;
 }
 
-void cstr_assign(cstring * this, const char * s)
+cstring * string_map(const char * path)
 {
-    if(this == NULL)
+    if(path == NULL)
+        return NULL;
+
+#if CSTR_POSIX
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // short files and anything that is not a regular file are simply read
+    size_t len = (size_t)st.st_size;
+    if(!S_ISREG(st.st_mode) || len <= CSTR_SSO_CAPACITY || (off_t)len != st.st_size || len >= LONG_MAX)
+    {
+        FILE * f = fdopen(fd, "rb");
+        if(f == NULL)
+        {
+            close(fd);
+            return NULL;
+        }
+        cstring * cs = cstr_read_file(f);
+        fclose(f);
+        return cs;
+    }
+
+    cstring * cs = malloc(sizeof(struct _cstring_));
+    size_t page = cstr_page_size();
+    size_t span = cstr_map_span(len);
+
+    // reserves the header page, the file and room for the terminator,
+    // then maps the file over the middle
+    char * base = cs == NULL ? MAP_FAILED : mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base != MAP_FAILED && mmap(base + page, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, span);
+        base = MAP_FAILED;
+    }
+    close(fd);
+
+    if(base == MAP_FAILED)
+    {
+        free(cs);
+        return NULL;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise(base + page, len, MADV_SEQUENTIAL);
+#endif
+
+    cs->str = (cstr)(base + page - sizeof(struct _cstr_));
+    cs->str->size = len;
+    cs->str->capacity = len;
+    cs->str->hash = 0;
+    atomic_init(&cs->str->refs, 0);
+    cstr_bind(cs);
+    cs->alloc = &cstr_mapped;
+
+    return cs;
+#else
+    FILE * f = fopen(path, "rb");
+    if(f == NULL)
+        return NULL;
+    cstring * cs = cstr_read_file(f);
+    fclose(f);
+    return cs;
+#endif
+}
+
+
+/// Modifiers ///
+
+const void cstr_append(cstring * this, const char * s)
+{
+    if(this == NULL || s == NULL)
+        return;
+    cstr_append_n(this, s, strlen(s));
+}
+
+const void cstr_append_n(cstring * this, const char * s, size_t len)
+{
+    if(this == NULL || (s == NULL && len))
+        return;
+
+    // s may point into our own buffer, remember where in case it moves
+    bool alias = s >= this->str->val && s <= this->str->val + this->str->size;
+    size_t off = alias ? (size_t)(s - this->str->val) : 0;
+
+    if(!cstr_grow(this, this->str->size + len))
         return;
+    if(alias)
+        s = this->str->val + off;
 
-    free(this->str);
-    this->str = new_cstr(s);
+    memmove(this->str->val + this->str->size, s, len);
+    this->str->size += len;
+    this->str->hash = 0;
+    this->str->val[this->str->size] = '\0';
 }
 
-void cstr_insert(cstring * this, size_t pos, const char * s)
+const void cstr_push_back(cstring * this, const char c)
 {
     if(this == NULL)
         return;
 
-    if(pos <= this->str->size)
-    {
-        size_t ns = this->str->size + CSTR_PAD + strlen(s);
-        size_t end = ns - pos - strlen(s) - CSTR_PAD;
-        char * sz = malloc(ns);
+    if(!cstr_grow(this, this->str->size + 1))
+        return;
 
-        memset(sz, 0, ns);
-        memcpy(sz, this->str->val, pos);
-        memcpy(sz + pos, s, strlen(s));
-        memcpy(sz + pos + strlen(s) , this->str->val + pos, end);
+    this->str->val[this->str->size++] = c;
+    this->str->hash = 0;
+    this->str->val[this->str->size] = '\0';
+}
+
+const void cstr_pop_back(cstring * this)
+{
+    if(this == NULL || this->str->size == 0)
+        return;
+    if(cstr_is_readonly(this))
+    {
+        cstr_detach(this, this->str->val, this->str->size - 1, this->str->size - 1);
+        return;
+    }
 
-        free(this->str);
+    this->str->val[--this->str->size] = '\0';
+    this->str->hash = 0;
+}
 
-        this->str = new_cstr(sz);
+const void cstr_assign(cstring * this, const char * s)
+{
+    if(this == NULL || s == NULL)
+        return;
+    cstr_assign_n(this, s, strlen(s));
+}
 
-        free(sz);
+const void cstr_assign_n(cstring * this, const char * s, size_t len)
+{
+    if(this == NULL || (s == NULL && len))
+        return;
+    if(cstr_is_readonly(this))
+    {
+        cstr_detach(this, s, len, len);
+        return;
     }
+
+    // a source inside our own buffer is never longer than it, so
+    // the buffer is only reallocated when s cannot be aliasing it
+    if(!cstr_grow(this, len))
+        return;
+
+    memmove(this->str->val, s, len);
+    this->str->size = len;
+    this->str->hash = 0;
+    this->str->val[len] = '\0';
 }
 
-void cstr_erase(cstring * this, size_t pos, size_t len)
+const void cstr_insert(cstring * this, size_t pos, const char * s)
 {
-    if(this == NULL)
+    if(this == NULL || s == NULL)
         return;
+    cstr_insert_n(this, pos, s, strlen(s));
+}
 
-    if(pos < this->str->size && len <= this->str->size)
+const void cstr_insert_n(cstring * this, size_t pos, const char * s, size_t len)
+{
+    if(this == NULL || (s == NULL && len))
+        return;
+
+    if(pos <= this->str->size)
     {
-        while(pos + len > this->str->size)
-            --len;
+        bool alias = s >= this->str->val && s <= this->str->val + this->str->size;
+        size_t off = alias ? (size_t)(s - this->str->val) : 0;
 
-        size_t ns = this->str->size - len + CSTR_PAD;
-        size_t end = this->str->size - pos - len;
-        char * sz = malloc(ns);
+        if(!cstr_grow(this, this->str->size + len))
+            return;
 
-        memset(sz, 0, ns);
-        memcpy(sz, this->str->val, pos);
-        memcpy(sz + pos, this->str->val + pos + len, end);
+        char * v = this->str->val;
+        if(alias)
+            s = v + off;
 
-        free(this->str);
+        // shifts the tail right to open a gap at pos
+        memmove(v + pos + len, v + pos, this->str->size - pos);
 
-        this->str = new_cstr(sz);
+        // a source that was in the shifted tail has moved with it
+        if(alias && off >= pos)
+            s += len;
+        // a source straddling pos has been split by the gap
+        if(alias && off < pos && off + len > pos)
+        {
+            size_t head = pos - off;
+            memmove(v + pos, s, head);
+            memmove(v + pos + head, v + pos + len, len - head);
+        }
+        else
+            memmove(v + pos, s, len);
+
+        this->str->size += len;
+        this->str->hash = 0;
+        v[this->str->size] = '\0';
+    }
+}
+
+const void cstr_erase(cstring * this, size_t pos, size_t len)
+{
+    if(this == NULL)
+        return;
 
-        free(sz);
+    if(pos < this->str->size && len <= this->str->size)
+    {
+        if(len > this->str->size - pos)
+            len = this->str->size - pos;
+        if(cstr_is_readonly(this) && !cstr_detach(this, this->str->val, this->str->size, this->str->size))
+            return;
+
+        // closes the gap by shifting the tail left, the capacity is kept
+        char * v = this->str->val;
+        memmove(v + pos, v + pos + len, this->str->size - pos - len);
+        this->str->size -= len;
+        this->str->hash = 0;
+        v[this->str->size] = '\0';
     }
 }
 
-void cstr_swap(cstring * this, cstring * str_2)
+const void cstr_swap(cstring * this, cstring * str_2)
 {
     if(this == NULL || str_2 == NULL)
         return;
 
-    cstr tmp = new_cstr(this->str->val);
-    this->str = new_cstr(str_2->str->val);
-    str_2->str = new_cstr(tmp->val);
-    free(tmp);
+    // heap blocks must go back to the allocator they came from,
+    // strings from different allocators exchange their contents instead
+    if(!cstr_same_heap(this->alloc, str_2->alloc) && !(cstr_is_inline(this) && cstr_is_inline(str_2)))
+    {
+        size_t len = this->str->size;
+        char * sz = cstr_mem_alloc(this->alloc, len + CSTR_PAD);
+        if(sz == NULL)
+            return;
+
+        memcpy(sz, this->str->val, len);
+        cstr_assign_n(this, str_2->str->val, str_2->str->size);
+        cstr_assign_n(str_2, sz, len);
+        cstr_mem_free(this->alloc, sz, len + CSTR_PAD);
+        return;
+    }
+
+    // each string is a single block so swapping the handles is enough,
+    // short strings travel with the sso storage and are re-pointed at it
+    bool inl_1 = cstr_is_inline(this);
+    bool inl_2 = cstr_is_inline(str_2);
+    cstr tmp = this->str;
+
+    if(inl_1 || inl_2)
+    {
+        size_t sso[sizeof(this->sso) / sizeof(size_t)];
+        memcpy(sso, this->sso, sizeof(sso));
+        memcpy(this->sso, str_2->sso, sizeof(sso));
+        memcpy(str_2->sso, sso, sizeof(sso));
+    }
+
+    this->str = inl_2 ? (cstr)this->sso : str_2->str;
+    str_2->str = inl_1 ? (cstr)str_2->sso : tmp;
+
+    // a heap block takes its mapped marker along, the heaps are otherwise the
+    // same. Two inline strings keep their allocators, which free the cstrings
+    if(!inl_1 || !inl_2)
+    {
+        const cstr_allocator * alloc = this->alloc;
+        this->alloc = str_2->alloc;
+        str_2->alloc = alloc;
+    }
 }
 
 
@@ -423,50 +994,152 @@ const size_t cstr_copy(cstring * this, char ** s, size_t pos, size_t len)
     return len;
 }
 
-const size_t cstr_find(cstring * this, const char * s, size_t * nxtpos)
-{
-    // valid string test
-    if(this == NULL || !strlen(s) || !this->str->size || strcmp(this->str->val,"") == 0)
-        return npos;
-
-    size_t ret = npos;
-    size_t ipos = 0;
-    size_t slen = strlen(s);
-    // checks for a previous search of this string and starts
-    // at a position after the last string
-    if(nxtpos != NULL)
-        ipos = *nxtpos;
+/// Substring Search ///
 
+// Each scanner returns the position of the first occurrence of the needle n
+// in the haystack h at or after ipos, or npos. Callers guarantee that
+// 2 <= nlen and ipos + nlen <= hlen, both may contain null characters
 
+static size_t cstr_scan_scalar(const char * h, size_t hlen, const char * n, size_t nlen, size_t ipos)
+{
     // logic : - check first and last char before checking string
-    // iterate through characters until mismatch or until full match
-    for( ; ipos != this->str->size && ipos + slen <= this->str->size; ++ipos)
+    // compare the characters between them only on a likely match
+    for( ; ipos + nlen <= hlen; ++ipos)
     {
-        char * ip = &this->str->val[ipos];
-        char * ep = (char*)&s[0];
+        const char * ip = &h[ipos];
+
+        // tests for start and end matching characters,
+        // this indicates a high probability match and investigates
+        if(*ip == n[0] && ip[nlen - 1] == n[nlen - 1]
+           && (nlen <= 2 || memcmp(ip + 1, n + 1, nlen - 2) == 0))
+            return ipos;
+    }
+
+    return npos;
+}
 
-        // Tests for single character length strings
-        if(slen - 1 == 0 && *ip == *ep)
+#if CSTR_SIMD
+
+// Vector versions of the same first/last character filter, every lane
+// compares one candidate position, only candidates whose first and last
+// characters both match fall through to memcmp
+
+__attribute__((target("sse2")))
+static size_t cstr_scan_sse2(const char * h, size_t hlen, const char * n, size_t nlen, size_t ipos)
+{
+    const __m128i first = _mm_set1_epi8(n[0]);
+    const __m128i last  = _mm_set1_epi8(n[nlen - 1]);
+
+    for( ; ipos + nlen - 1 + 16 <= hlen; ipos += 16)
+    {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(h + ipos));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(h + ipos + nlen - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf),
+                                                        _mm_cmpeq_epi8(last, bl)));
+        for( ; mask; mask &= mask - 1)
         {
-            ret = ipos;
-            break;
+            size_t i = ipos + __builtin_ctz(mask);
+            if(memcmp(h + i + 1, n + 1, nlen - 2) == 0)
+                return i;
         }
+    }
 
-        // tests for start and end matching characters,
-        // this indicates a high probability match and investigates
-        if(*ip == *ep && *(ip + slen - 1) == *(ep + slen - 1))
+    return cstr_scan_scalar(h, hlen, n, nlen, ipos);
+}
+
+__attribute__((target("avx2")))
+static size_t cstr_scan_avx2(const char * h, size_t hlen, const char * n, size_t nlen, size_t ipos)
+{
+    const __m256i first = _mm256_set1_epi8(n[0]);
+    const __m256i last  = _mm256_set1_epi8(n[nlen - 1]);
+
+    for( ; ipos + nlen - 1 + 32 <= hlen; ipos += 32)
+    {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(h + ipos));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(h + ipos + nlen - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, bf),
+                                                              _mm256_cmpeq_epi8(last, bl)));
+        for( ; mask; mask &= mask - 1)
         {
-            while(*++ip == *++ep && (*(ip + 1) && *(ep + 1)));
-            // tests for a complete match by seeing if the search went
-            // the entire way through the search string
-            if(*ep == s[slen-1])
-            {
-                ret = ipos;
-                break;
-            }
+            size_t i = ipos + __builtin_ctz(mask);
+            if(memcmp(h + i + 1, n + 1, nlen - 2) == 0)
+                return i;
+        }
+    }
+
+    return cstr_scan_sse2(h, hlen, n, nlen, ipos);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t cstr_scan_avx512(const char * h, size_t hlen, const char * n, size_t nlen, size_t ipos)
+{
+    const __m512i first = _mm512_set1_epi8(n[0]);
+    const __m512i last  = _mm512_set1_epi8(n[nlen - 1]);
+
+    for( ; ipos + nlen - 1 + 64 <= hlen; ipos += 64)
+    {
+        __m512i bf = _mm512_loadu_si512((const void*)(h + ipos));
+        __m512i bl = _mm512_loadu_si512((const void*)(h + ipos + nlen - 1));
+        unsigned long long mask = _mm512_cmpeq_epi8_mask(first, bf) & _mm512_cmpeq_epi8_mask(last, bl);
+        for( ; mask; mask &= mask - 1)
+        {
+            size_t i = ipos + __builtin_ctzll(mask);
+            if(memcmp(h + i + 1, n + 1, nlen - 2) == 0)
+                return i;
         }
     }
 
+    return cstr_scan_avx2(h, hlen, n, nlen, ipos);
+}
+
+// SSE2 is part of every x86-64 processor, wider versions are picked
+// once at startup by cstr_simd_select if the CPU (and OS) support them
+static size_t (*cstr_scan_impl)(const char *, size_t, const char *, size_t, size_t) = &cstr_scan_sse2;
+
+#else
+
+static size_t (*cstr_scan_impl)(const char *, size_t, const char *, size_t, size_t) = &cstr_scan_scalar;
+
+#endif
+
+// Returns the position of the first occurrence of the needle n in the
+// haystack h at or after ipos, or npos. Both may contain null characters
+static size_t cstr_scan(const char * h, size_t hlen, const char * n, size_t nlen, size_t ipos)
+{
+    if(!nlen || nlen > hlen || ipos > hlen - nlen)
+        return npos;
+
+    // single characters are left to the C library's memchr
+    if(nlen == 1)
+    {
+        const char * p = memchr(h + ipos, n[0], hlen - ipos);
+        return p == NULL ? npos : (size_t)(p - h);
+    }
+
+    return cstr_scan_impl(h, hlen, n, nlen, ipos);
+}
+
+const size_t cstr_find(cstring * this, const char * s, size_t * nxtpos)
+{
+    if(this == NULL || s == NULL)
+        return npos;
+    return cstr_find_n(this, s, strlen(s), nxtpos);
+}
+
+const size_t cstr_find_n(cstring * this, const char * s, size_t slen, size_t * nxtpos)
+{
+    // valid string test
+    if(this == NULL || s == NULL || !slen || !this->str->size)
+        return npos;
+
+    size_t ipos = 0;
+    // checks for a previous search of this string and starts
+    // at a position after the last string
+    if(nxtpos != NULL)
+        ipos = *nxtpos;
+
+    size_t ret = cstr_scan(this->str->val, this->str->size, s, slen, ipos);
+
     // sets the next search position if another search is run
     if(nxtpos != NULL)
         *nxtpos = ret + slen;
@@ -474,141 +1147,246 @@ const size_t cstr_find(cstring * this, const char * s, size_t * nxtpos)
     return ret;
 }
 
-const size_t cstr_find_first_of(cstring * this, const char * s, size_t pos)
+const size_t cstr_find_pattern(cstring * this, cstr_pattern pat, size_t * nxtpos)
 {
-    // valid string test
-    if(this == NULL || !strlen(s) || !this->str->size || strcmp(this->str->val,"") == 0)
+    if(this == NULL || pat == NULL)
         return npos;
 
-    size_t ret = npos;
-    size_t ipos = pos;
-    size_t slen = strlen(s);
+    size_t ret = cstr_pattern_find(pat, cstr_view_of(this), nxtpos == NULL ? 0 : *nxtpos);
 
-    // reads through the string forwards
-    for( ; ipos <= this->str->size; ++ipos)
-    {
-        char * ip = &this->str->val[ipos];  // internal pointer
-        char * sp = (char*)&s[0];                  // start pointer
-        char * ep = (char*)&s[slen-1];             // end pointer
+    // sets the next search position if another search is run
+    if(nxtpos != NULL)
+        *nxtpos = ret + pat->len;
 
-        // iterate through search str for any matches to current pointer
-        // only does this for searches larger than a single character
-        if(slen > 1)
-            while((*ip != *sp && *ip != *ep) && ++sp != ep && --ep != sp);
+    return ret;
+}
 
-        // tests for any matches
-        if(*ip == *sp || *ip == *ep)
-        {
-            ret = ipos;
-            break;
-        }
+const size_t cstr_find_all(cstring * this, cstr_pattern pat, size_t * out, size_t max, bool overlap)
+{
+    if(this == NULL || pat == NULL)
+        return 0;
+
+    cstr_matches it = cstr_pattern_matches(pat, cstr_view_of(this), overlap);
+    size_t count = 0;
+    size_t pos;
+
+    while(cstr_matches_next(&it, &pos))
+    {
+        if(count < max)
+            out[count] = pos;
+        ++count;
     }
 
-    return ret;
+    return count;
 }
 
-const size_t cstr_find_last_of(cstring * this, const char * s, size_t pos)
+const size_t cstr_find_any(cstring * this, cstr_automaton ac, cstr_hit * out, size_t max)
 {
-    // valid string test
-    if(this == NULL || !strlen(s) || !this->str->size || strcmp(this->str->val,"") == 0)
-        return npos;
+    if(this == NULL)
+        return 0;
+    return cstr_automaton_scan(ac, cstr_view_of(this), out, max);
+}
+
+const size_t cstr_split_into(cstring * this, const cstr_charset * set, cstr_token * out, size_t max, bool collapse)
+{
+    if(this == NULL || set == NULL || out == NULL || max == 0)
+        return 0;
+
+    cstr_split it = cstr_split_on(cstr_view_of(this), set, max, collapse);
+    return cstr_split_all(&it, out, max);
+}
+
+
+/// Character Class Search ///
+
+// Each scanner looks at the positions of h in [pos, hlen) and returns the
+// first (span) or last (rspan) one whose membership of the set equals 'in',
+// or npos when there is none
+
+static inline bool cstr_in_set(const cstr_charset * set, unsigned char c)
+{
+    return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static size_t cstr_span_scalar(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    for( ; pos < hlen; ++pos)
+        if(cstr_in_set(set, h[pos]) == in)
+            return pos;
+    return npos;
+}
+
+static size_t cstr_rspan_scalar(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    while(hlen-- > pos)
+        if(cstr_in_set(set, h[hlen]) == in)
+            return hlen;
+    return npos;
+}
+
+#if CSTR_SIMD
+
+// Nibble-shuffle classification, the low nibble of each character picks the
+// row of high nibbles that are in the set (one row for high nibbles 0-7 and
+// one for 8-15) and the high nibble picks its bit within that row
+
+static const uint8_t cstr_nibble_bit[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                             1, 2, 4, 8, 16, 32, 64, 128 };
+
+__attribute__((target("ssse3")))
+static inline unsigned cstr_classify_ssse3(const char * p, const cstr_charset * set, bool in)
+{
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    const __m128i b   = _mm_loadu_si128((const __m128i*)p);
+    __m128i lo   = _mm_and_si128(b, nib);
+    __m128i hi   = _mm_and_si128(_mm_srli_epi16(b, 4), nib);
+    __m128i high = _mm_cmpgt_epi8(hi, _mm_set1_epi8(7));
+    __m128i row  = _mm_or_si128(_mm_andnot_si128(high, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)set->lo[0]), lo)),
+                                _mm_and_si128(high, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)set->lo[1]), lo)));
+    __m128i bit  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)cstr_nibble_bit), hi);
+    unsigned out = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128()));
+    return in ? ~out & 0xffff : out;
+}
 
-    size_t ret = npos;
-    size_t ipos = this->str->size-1;
-    size_t slen = strlen(s);
+__attribute__((target("ssse3")))
+static size_t cstr_span_ssse3(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    for( ; pos + 16 <= hlen; pos += 16)
+    {
+        unsigned mask = cstr_classify_ssse3(h + pos, set, in);
+        if(mask)
+            return pos + __builtin_ctz(mask);
+    }
+    return cstr_span_scalar(h, hlen, set, pos, in);
+}
 
-    // reads through the string backwards
-    for( ; ipos >= pos && ipos > 0; --ipos)
+__attribute__((target("ssse3")))
+static size_t cstr_rspan_ssse3(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    for( ; hlen >= pos + 16; hlen -= 16)
     {
-        char * ip = &this->str->val[ipos];  // internal pointer
-        char * sp = (char*)&s[0];                  // start pointer
-        char * ep = (char*)&s[slen-1];             // end pointer
+        unsigned mask = cstr_classify_ssse3(h + hlen - 16, set, in);
+        if(mask)
+            return hlen - 16 + 31 - __builtin_clz(mask);
+    }
+    return cstr_rspan_scalar(h, hlen, set, pos, in);
+}
 
-        // iterate through search str for any matches to current pointer
-        // only does this for searches larger than a single character
-        if(slen > 1)
-            while((*ip != *sp && *ip != *ep) && ++sp != ep && --ep != sp);
+__attribute__((target("avx2")))
+static inline unsigned cstr_classify_avx2(const char * p, const cstr_charset * set, bool in)
+{
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    const __m256i b   = _mm256_loadu_si256((const __m256i*)p);
+    __m256i lo   = _mm256_and_si256(b, nib);
+    __m256i hi   = _mm256_and_si256(_mm256_srli_epi16(b, 4), nib);
+    __m256i row0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->lo[0]));
+    __m256i row1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->lo[1]));
+    __m256i bits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)cstr_nibble_bit));
+    __m256i row  = _mm256_blendv_epi8(_mm256_shuffle_epi8(row0, lo), _mm256_shuffle_epi8(row1, lo),
+                                      _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(7)));
+    __m256i bit  = _mm256_shuffle_epi8(bits, hi);
+    unsigned out = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256()));
+    return in ? ~out : out;
+}
 
-        // tests for any matches
-        if(*ip == *sp || *ip == *ep)
-        {
-            ret = ipos;
-            break;
-        }
+__attribute__((target("avx2")))
+static size_t cstr_span_avx2(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    for( ; pos + 32 <= hlen; pos += 32)
+    {
+        unsigned mask = cstr_classify_avx2(h + pos, set, in);
+        if(mask)
+            return pos + __builtin_ctz(mask);
     }
+    return cstr_span_ssse3(h, hlen, set, pos, in);
+}
 
-    return ret;
+__attribute__((target("avx2")))
+static size_t cstr_rspan_avx2(const char * h, size_t hlen, const cstr_charset * set, size_t pos, bool in)
+{
+    for( ; hlen >= pos + 32; hlen -= 32)
+    {
+        unsigned mask = cstr_classify_avx2(h + hlen - 32, set, in);
+        if(mask)
+            return hlen - 32 + 31 - __builtin_clz(mask);
+    }
+    return cstr_rspan_ssse3(h, hlen, set, pos, in);
 }
 
-const size_t cstr_find_first_not_of(cstring * this, const char * s, size_t pos)
+#endif
+
+static size_t (*cstr_span_impl)(const char *, size_t, const cstr_charset *, size_t, bool) = &cstr_span_scalar;
+static size_t (*cstr_rspan_impl)(const char *, size_t, const cstr_charset *, size_t, bool) = &cstr_rspan_scalar;
+
+// Runs a character class search over the string, the shared
+// validity checks of the find_..._of and find_..._in members
+static size_t cstr_span(cstring * this, const cstr_charset * set, size_t pos, bool in, bool reverse)
+{
+    if(this == NULL || set == NULL || pos >= this->str->size)
+        return npos;
+
+    return reverse ? cstr_rspan_impl(this->str->val, this->str->size, set, pos, in)
+                   : cstr_span_impl(this->str->val, this->str->size, set, pos, in);
+}
+
+const size_t cstr_find_first_of(cstring * this, const char * s, size_t pos)
 {
     // valid string test
-    if(this == NULL || !strlen(s) || !this->str->size || strcmp(this->str->val,"") == 0)
+    if(s == NULL || !*s)
         return npos;
 
-    size_t ret = npos;
-    size_t ipos = pos;
-    size_t slen = strlen(s);
+    cstr_charset set = cstr_charset_of(s);
+    return cstr_span(this, &set, pos, true, false);
+}
 
-    // reads through the string forwards
-    for( ; ipos < this->str->size; ++ipos)
-    {
-        char * ip = &this->str->val[ipos];  // internal pointer
-        char * sp = (char*)&s[0];                  // start pointer
-        char * ep = (char*)&s[slen-1];             // end pointer
+const size_t cstr_find_last_of(cstring * this, const char * s, size_t pos)
+{
+    // valid string test
+    if(s == NULL || !*s)
+        return npos;
 
-        // iterate through search str for any matches to current pointer
-        // only does this for searches larger than a single character
-        if(slen > 1)
-            while((*ip != *sp && *ip != *ep) && ++sp != ep && --ep != sp);
+    cstr_charset set = cstr_charset_of(s);
+    return cstr_span(this, &set, pos, true, true);
+}
 
-        // tests for any matches, continues to search if a match is found
-        // otherwise it escapes and returns the position
-        if(*ip == *sp || *ip == *ep)
-            continue;
-        else
-        {
-            ret = ipos;
-            break;
-        }
-    }
+const size_t cstr_find_first_not_of(cstring * this, const char * s, size_t pos)
+{
+    // valid string test
+    if(s == NULL || !*s)
+        return npos;
 
-    return ret;
+    cstr_charset set = cstr_charset_of(s);
+    return cstr_span(this, &set, pos, false, false);
 }
 
 const size_t cstr_find_last_not_of(cstring * this, const char * s, size_t pos)
 {
     // valid string test
-    if(this == NULL || !strlen(s) || !this->str->size || strcmp(this->str->val,"") == 0)
+    if(s == NULL || !*s)
         return npos;
 
-    size_t ret = npos;
-    size_t ipos = this->str->size-1;
-    size_t slen = strlen(s);
+    cstr_charset set = cstr_charset_of(s);
+    return cstr_span(this, &set, pos, false, true);
+}
 
-    // reads through the string backwards
-    for( ; ipos >= pos && ipos > 0; --ipos)
-    {
-        char * ip = &this->str->val[ipos];  // internal pointer
-        char * sp = (char*)&s[0];                  // start pointer
-        char * ep = (char*)&s[slen-1];             // end pointer
+const size_t cstr_find_first_in(cstring * this, const cstr_charset * set, size_t pos)
+{
+    return cstr_span(this, set, pos, true, false);
+}
 
-        // iterate through search str for any matches to current pointer
-        // only does this for searches larger than a single character
-        if(slen > 1)
-            while((*ip != *sp && *ip != *ep) && ++sp != ep && --ep != sp);
+const size_t cstr_find_last_in(cstring * this, const cstr_charset * set, size_t pos)
+{
+    return cstr_span(this, set, pos, true, true);
+}
 
-        // tests for any matches
-        if(*ip == *sp || *ip == *ep)
-            continue;
-        else
-        {
-            ret = ipos;
-            break;
-        }
-    }
+const size_t cstr_find_first_not_in(cstring * this, const cstr_charset * set, size_t pos)
+{
+    return cstr_span(this, set, pos, false, false);
+}
 
-    return ret;
+const size_t cstr_find_last_not_in(cstring * this, const cstr_charset * set, size_t pos)
+{
+    return cstr_span(this, set, pos, false, true);
 }
 
 const char * cstr_substr(cstring * this, size_t pos, size_t len)
@@ -634,138 +1412,3883 @@ const char * cstr_substr(cstring * this, size_t pos, size_t len)
 
 const bool   cstr_compare(cstring * this, const char * s)
 {
-    if(this == NULL)
+    if(this == NULL || s == NULL)
         return false;
-    if(strlen(s) == this->str->size)
-    {
-        char * c1 = &this->str->val[0];
-        char * c2 = (char*)&s[0];
-
-        if(*c1 != *c2)
-            return false;
-
-        while(*c1++ && *c2++)
-            if(*c1 != *c2)
-                return false;
+    return cstr_compare_n(this, s, strlen(s));
+}
 
-        return true;
-    }
+const bool   cstr_compare_n(cstring * this, const char * s, size_t len)
+{
+    if(this == NULL || (s == NULL && len))
+        return false;
+    return len == this->str->size && memcmp(this->str->val, s, len) == 0;
+}
 
-    return false;
+const cstr_view cstr_view_of(cstring * this)
+{
+    if(this == NULL)
+        return cstr_view_n("", 0);
+    return cstr_view_n(this->str->val, this->str->size);
 }
 
-const bool   cstr_instr(cstring * this, const char *s)
+const cstr_view cstr_subview(cstring * this, size_t pos, size_t len)
 {
     if(this == NULL)
-        return false;
+        return cstr_view_n("", 0);
+    return cstr_view_substr(cstr_view_of(this), pos, len);
+}
 
-    return cstr_find(this,s,0) == npos ? false : true;
+const void   cstr_append_view(cstring * this, cstr_view v)
+{
+    cstr_append_n(this, v.ptr, v.len);
 }
 
+const void   cstr_assign_view(cstring * this, cstr_view v)
+{
+    cstr_assign_n(this, v.ptr, v.len);
+}
 
+const void   cstr_insert_view(cstring * this, size_t pos, cstr_view v)
+{
+    cstr_insert_n(this, pos, v.ptr, v.len);
+}
 
-/// Capacity ///
-const size_t cstr_len(cstring * this)
+const size_t cstr_find_view(cstring * this, cstr_view v, size_t * nxtpos)
 {
-    if(this == NULL)
-        return npos;
-    return this->str->size;
+    return cstr_find_n(this, v.ptr, v.len, nxtpos);
 }
 
-const size_t cstr_max(cstring * this)
+const bool   cstr_compare_view(cstring * this, cstr_view v)
 {
-    if(this == NULL)
-        return npos;
-    return LONG_MAX;
+    return cstr_compare_n(this, v.ptr, v.len);
 }
 
-const size_t cstr_resize(cstring * this, size_t nsize)
+// wyhash (Wang Yi, final version 4), a fast hash whose 64 bit multiply and
+// fold steps mix every input byte into the result
+static const uint64_t cstr_wyp[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                      0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+// the 128 bit product of a and b, low half in a and high half in b
+static inline void cstr_wymum(uint64_t * a, uint64_t * b)
 {
-    if(this == NULL)
-        return npos;
-    if(nsize > 0 && nsize < LONG_MAX && nsize != this->str->size)
-    {
-        size_t ns = nsize + CSTR_PAD;
-        char * sz = malloc(ns);
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
 
-        memset(sz, 0, ns);
-        if(ns > this->str->size)
-            memcpy(sz, this->str->val,this->str->size);
-        else
-            memcpy(sz, this->str->val,ns-1);
+static inline uint64_t cstr_wymix(uint64_t a, uint64_t b)
+{
+    cstr_wymum(&a, &b);
+    return a ^ b;
+}
 
-        free(this->str->val);
-        this->str->val = malloc(ns);
+static inline uint64_t cstr_wyr8(const uint8_t * p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t cstr_wyr4(const uint8_t * p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
 
-        this->str->size = ns - 1;
-        this->str->allocator_size = sizeof(struct _cstr_) + ns;
-        memcpy(this->str->val, sz, ns);
+static uint64_t cstr_wyhash(const void * key, size_t len)
+{
+    const uint8_t * p = key;
+    uint64_t seed = cstr_wymix(cstr_wyp[0], cstr_wyp[1]);
+    uint64_t a, b;
 
-        free(sz);
+    if(len <= 16)
+    {
+        if(len >= 4)
+        {
+            a = (cstr_wyr4(p) << 32) | cstr_wyr4(p + ((len >> 3) << 2));
+            b = (cstr_wyr4(p + len - 4) << 32) | cstr_wyr4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if(len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
     }
     else
     {
-        nsize = npos;
+        size_t i = len;
+        if(i > 48)
+        {
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = cstr_wymix(cstr_wyr8(p) ^ cstr_wyp[1], cstr_wyr8(p + 8) ^ seed);
+                see1 = cstr_wymix(cstr_wyr8(p + 16) ^ cstr_wyp[2], cstr_wyr8(p + 24) ^ see1);
+                see2 = cstr_wymix(cstr_wyr8(p + 32) ^ cstr_wyp[3], cstr_wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            }
+            while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while(i > 16)
+        {
+            seed = cstr_wymix(cstr_wyr8(p) ^ cstr_wyp[1], cstr_wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        a = cstr_wyr8(p + i - 16);
+        b = cstr_wyr8(p + i - 8);
     }
 
-    return nsize;
+    a ^= cstr_wyp[1];
+    b ^= seed;
+    cstr_wymum(&a, &b);
+    return cstr_wymix(a ^ cstr_wyp[0] ^ len, b ^ cstr_wyp[1]);
 }
 
-void   cstr_clear(cstring * this)
+const uint64_t cstr_hash(cstring * this)
 {
     if(this == NULL)
-        return;
-    this->str = new_cstr("");
+        return 0;
+
+    if(this->str->hash != 0)
+        return this->str->hash;
+
+    // a result of 0 is simply never cached, nor is one for a shared block
+    // as other threads may be reading its header
+    uint64_t h = cstr_wyhash(this->str->val, this->str->size);
+    if(cstr_is_inline(this) || !cstr_is_shared(this))
+        this->str->hash = h;
+    return h;
 }
 
-const bool   cstr_empty(cstring * this)
+const bool   cstr_instr(cstring * this, const char *s)
 {
     if(this == NULL)
         return false;
-    return this->str->size == 0;
+
+    return cstr_find(this,s,0) == npos ? false : true;
 }
 
-void   cstr_shrink(cstring * this)
-{
-    if(this == NULL)
-        return;
 
-    while(--this->str->size > strlen(this->str->val));
 
-    this->str = new_cstr(this->str->val);
-}
+/// Numeric Conversion ///
 
-/// Iterators ///
-cstr_iterator cstr_begin(cstring * this)
+static const char cstr_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+static const uint64_t cstr_pow10_u64[20] =
 {
-    if(this == NULL)
-        return (cstr_iterator)ITR_END;
-    cstr_iterator itr = cstr_itr(ITR_BI_DIRECTIONAL);
-    this->str->size != 0 ? (itr->set((cstr_iterator)itr->base,&this->str->val[0]))
-                         : (itr->set((cstr_iterator)itr->base,(char*)&this->str->end));
-    return itr;
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+// Number of decimal digits in v
+static unsigned cstr_count_digits(uint64_t v)
+{
+    unsigned n = 1;
+    for(;;)
+    {
+        if(v < 10)
+            return n;
+        if(v < 100)
+            return n + 1;
+        if(v < 1000)
+            return n + 2;
+        if(v < 10000)
+            return n + 3;
+        v /= 10000;
+        n += 4;
+    }
 }
 
-cstr_iterator cstr_rbegin(cstring * this)
+// Writes the digits of v so they end just before end, two at a time
+static void cstr_write_digits(char * end, uint64_t v)
 {
-    if(this == NULL)
-        return (cstr_iterator)ITR_END;
-    cstr_iterator itr = cstr_itr(ITR_R_BI_DIRECTIONAL);
-    this->str->size != 0 ? (itr->set((cstr_iterator)itr->base,&this->str->val[this->str->size-1]))
-                         : (itr->set((cstr_iterator)itr->base,(char*)&this->str->rend));
-    return itr;
+    while(v >= 100)
+    {
+        unsigned i = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--end = cstr_digit_pairs[i + 1];
+        *--end = cstr_digit_pairs[i];
+    }
+
+    if(v >= 10)
+    {
+        *--end = cstr_digit_pairs[v * 2 + 1];
+        *--end = cstr_digit_pairs[v * 2];
+    }
+    else
+        *--end = (char)('0' + v);
 }
 
-cstr_iterator cstr_end(cstring * this)
+static void cstr_append_digits(cstring * this, uint64_t v, bool neg)
+{
+    size_t n = cstr_count_digits(v) + neg;
+    if(!cstr_grow(this, this->str->size + n))
+        return;
+
+    char * p = this->str->val + this->str->size;
+    if(neg)
+        *p = '-';
+    cstr_write_digits(p + n, v);
+
+    this->str->size += n;
+    this->str->hash = 0;
+    this->str->val[this->str->size] = '\0';
+}
+
+const void cstr_append_int(cstring * this, int64_t val)
 {
     if(this == NULL)
-        return (cstr_iterator)ITR_END;
-    return (cstr_iterator)this->str->end;
+        return;
+    // negating as unsigned keeps INT64_MIN in range
+    cstr_append_digits(this, val < 0 ? 0 - (uint64_t)val : (uint64_t)val, val < 0);
 }
 
-cstr_iterator cstr_rend(cstring * this)
+const void cstr_append_uint(cstring * this, uint64_t val)
 {
     if(this == NULL)
-        return (cstr_iterator)ITR_END;
-    return (cstr_iterator)this->str->rend;
+        return;
+    cstr_append_digits(this, val, false);
+}
+
+// Shortest round trip doubles using Grisu3 (Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers"). A value is held as a 64 bit
+// significand f and a binary exponent e, the number f * 2^e. Grisu3 tells when
+// its approximations leave the result in doubt, about 0.5% of doubles, and
+// those are left to the C library's correctly rounded printf
+typedef struct { uint64_t f; int e; } cstr_fp;
+
+// normalized 10^k for k = -348, -340, ... 340
+static const uint64_t cstr_cached_f[87] =
+{
+    0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+    0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+    0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+    0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+    0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+    0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+    0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+    0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+    0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+    0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+    0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+    0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+    0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+    0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+    0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+    0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+    0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+    0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+    0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+    0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+    0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+    0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+    0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+    0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+    0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+    0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+    0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+    0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+    0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+static const int16_t cstr_cached_e[87] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+// the upper 64 bits of the product, rounded
+static cstr_fp cstr_fp_mul(cstr_fp a, cstr_fp b)
+{
+    const uint64_t m32 = 0xFFFFFFFFu;
+    uint64_t a0 = a.f >> 32, a1 = a.f & m32, b0 = b.f >> 32, b1 = b.f & m32;
+    uint64_t ac = a0 * b0, bc = a1 * b0, ad = a0 * b1, bd = a1 * b1;
+    uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (1u << 31);
+
+    cstr_fp r = { ac + (ad >> 32) + (bc >> 32) + (mid >> 32), a.e + b.e + 64 };
+    return r;
+}
+
+// Moves the last digit down towards w while the digits stay inside the unsafe
+// interval, then tells whether they are certainly the closest of the shortest.
+// Every quantity is scaled by the same power of two, unit is the error of the
+// scaled boundaries and ten_kappa the weight of the last digit
+static bool cstr_grisu_weed(char * buf, int len, uint64_t high_w, uint64_t unsafe,
+                            uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+{
+    uint64_t small = high_w - unit, big = high_w + unit;
+
+    while(rest < small && unsafe - rest >= ten_kappa &&
+          (rest + ten_kappa < small || small - rest >= rest + ten_kappa - small))
+    {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+
+    // the next lower digits may be closer to w as well, the result is in doubt
+    if(rest < big && unsafe - rest >= ten_kappa &&
+       (rest + ten_kappa < big || big - rest > rest + ten_kappa - big))
+        return false;
+
+    // so close to an end of the interval that the error could take it outside
+    return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+// Generates the digits of the upper boundary, widened by the error of the
+// scaling, until they fall inside the boundaries around w. Returns the digit
+// count and adds the decimal exponent to K, or returns 0 if the result is in doubt
+static int cstr_grisu_digits(cstr_fp low, cstr_fp w, cstr_fp high, char * buf, int * K)
+{
+    uint64_t unit = 1;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe = too_high - (low.f - unit);
+    cstr_fp one = { 1ull << -w.e, w.e };
+    uint32_t p1 = (uint32_t)(too_high >> -one.e);
+    uint64_t p2 = too_high & (one.f - 1);
+    int kappa = (int)cstr_count_digits(p1);
+    int len = 0;
+
+    // integral part
+    while(kappa > 0)
+    {
+        uint32_t div = (uint32_t)cstr_pow10_u64[kappa - 1];
+        buf[len++] = (char)('0' + p1 / div);
+        p1 %= div;
+        kappa--;
+
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if(rest < unsafe)
+        {
+            *K += kappa;
+            return cstr_grisu_weed(buf, len, too_high - w.f, unsafe, rest, (uint64_t)div << -one.e, unit) ? len : 0;
+        }
+    }
+
+    // fractional part, the error grows with every digit
+    for(;;)
+    {
+        p2 *= 10;
+        unit *= 10;
+        unsafe *= 10;
+        buf[len++] = (char)('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        kappa--;
+
+        if(p2 < unsafe)
+        {
+            *K += kappa;
+            return cstr_grisu_weed(buf, len, (too_high - w.f) * unit, unsafe, p2, one.f, unit) ? len : 0;
+        }
+    }
+}
+
+// Writes the shortest digits of a positive finite value into buf, the value
+// is digits * 10^K. Returns the digit count, or 0 if the result is in doubt
+static int cstr_grisu3(double value, char * buf, int * K)
+{
+    const uint64_t hidden = 1ull << 52;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    int be = (int)(bits >> 52 & 0x7FF);
+    cstr_fp v = { bits & (hidden - 1), be ? be - 1075 : -1074 };
+    if(be)
+        v.f += hidden;
+
+    // the boundaries halfway to the neighbouring doubles, sharing one exponent.
+    // The lower neighbour is closer only above the smallest normal exponent
+    cstr_fp plus = { (v.f << 1) + 1, v.e - 1 };
+    while(!(plus.f & (hidden << 1)))
+    {
+        plus.f <<= 1;
+        plus.e--;
+    }
+    plus.f <<= 10;
+    plus.e -= 10;
+
+    cstr_fp minus = v.f == hidden && be > 1 ? (cstr_fp){ (v.f << 2) - 1, v.e - 2 } : (cstr_fp){ (v.f << 1) - 1, v.e - 1 };
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    while(!(v.f & (1ull << 63)))
+    {
+        v.f <<= 1;
+        v.e--;
+    }
+
+    // a power of ten that brings the exponent into [-60, -32]
+    double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if(dk - k > 0.0)
+        k++;
+    unsigned index = (unsigned)((k >> 3) + 1);
+    *K = -(-348 + (int)index * 8);
+
+    cstr_fp c = { cstr_cached_f[index], cstr_cached_e[index] };
+    return cstr_grisu_digits(cstr_fp_mul(minus, c), cstr_fp_mul(v, c), cstr_fp_mul(plus, c), buf, K);
+}
+
+// Reads the digits and exponent of "d.ddde+x" into buf and K
+static int cstr_read_exp_form(const char * s, char * buf, int * K)
+{
+    int len = 0;
+    for( ; *s != 'e'; s++)
+        if((unsigned char)(*s - '0') < 10)
+            buf[len++] = *s;
+
+    *K = atoi(s + 1) - (len - 1);
+    return len;
+}
+
+// The shortest digits by asking the C library for more of them until they
+// read back, for the doubles Grisu3 leaves in doubt. printf rounds correctly
+// so the first that reads back is also the closest, except below a power of
+// two where the gap to the lower neighbour is half as wide and the digits
+// rounded up may read back when those rounded to nearest do not
+static int cstr_exact_digits(double value, char * buf, int * K)
+{
+    char tmp[40];
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    for(int prec = 0; prec < 16; prec++)
+    {
+        snprintf(tmp, sizeof(tmp), "%.*e", prec, value);
+        if(strtod(tmp, NULL) == value)
+            return cstr_read_exp_form(tmp, buf, K);
+
+        if((bits & ((1ull << 52) - 1)) == 0)
+        {
+            // the next decimal up at the same precision, 9.99e5 becomes 1.00e6
+            int len = cstr_read_exp_form(tmp, buf, K), i = len - 1;
+            while(i >= 0 && buf[i] == '9')
+                buf[i--] = '0';
+            if(i < 0)
+            {
+                buf[0] = '1';
+                ++*K;
+            }
+            else
+                buf[i]++;
+            while(len > 1 && buf[len - 1] == '0')
+            {
+                len--;
+                ++*K;
+            }
+
+            snprintf(tmp, sizeof(tmp), "%.*se%d", len, buf, *K);
+            if(strtod(tmp, NULL) == value)
+                return len;
+        }
+    }
+
+    snprintf(tmp, sizeof(tmp), "%.16e", value);
+    return cstr_read_exp_form(tmp, buf, K);
+}
+
+// Lays out len digits scaled by 10^K in place, plain notation for values from
+// 1e-6 up to 1e21 and exponent notation outside that. Returns the new length
+static size_t cstr_format_digits(char * buf, int len, int K)
+{
+    int kk = len + K;   // 10^(kk-1) <= value < 10^kk
+
+    if(len <= kk && kk <= 21)
+    {
+        // 1234e7 -> 12340000000
+        memset(buf + len, '0', kk - len);
+        return kk;
+    }
+    if(0 < kk && kk <= 21)
+    {
+        // 1234e-2 -> 12.34
+        memmove(buf + kk + 1, buf + kk, len - kk);
+        buf[kk] = '.';
+        return len + 1;
+    }
+    if(-6 < kk && kk <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        int off = 2 - kk;
+        memmove(buf + off, buf, len);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', off - 2);
+        return len + off;
+    }
+
+    // 1234e30 -> 1.234e+33
+    size_t n = 1;
+    if(len > 1)
+    {
+        memmove(buf + 2, buf + 1, len - 1);
+        buf[1] = '.';
+        n = len + 1;
+    }
+
+    int exp = kk - 1;
+    buf[n++] = 'e';
+    buf[n++] = exp < 0 ? '-' : '+';
+    exp = exp < 0 ? -exp : exp;
+    unsigned digits = cstr_count_digits((uint64_t)exp);
+    cstr_write_digits(buf + n + digits, (uint64_t)exp);
+    return n + digits;
+}
+
+const void cstr_append_double(cstring * this, double val)
+{
+    if(this == NULL)
+        return;
+
+    if(val != val)
+    {
+        cstr_append_n(this, "nan", 3);
+        return;
+    }
+
+    // the longest result is a sign, 17 digits, a point and "e-308"
+    if(!cstr_grow(this, this->str->size + 32))
+        return;
+
+    char * p = this->str->val + this->str->size;
+    size_t n = 0;
+
+    if(signbit(val))
+    {
+        p[n++] = '-';
+        val = -val;
+    }
+
+    if(val == 0)
+        p[n++] = '0';
+    else if(isinf(val))
+    {
+        memcpy(p + n, "inf", 3);
+        n += 3;
+    }
+    else
+    {
+        int K;
+        int len = cstr_grisu3(val, p + n, &K);
+        if(len == 0)
+            len = cstr_exact_digits(val, p + n, &K);
+        n += cstr_format_digits(p + n, len, K);
+    }
+
+    this->str->size += n;
+    this->str->hash = 0;
+    this->str->val[this->str->size] = '\0';
+}
+
+static inline bool cstr_is_digit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+static size_t cstr_skip_space(cstr_view v)
+{
+    size_t i = 0;
+    while(i < v.len && (v.ptr[i] == ' ' || (unsigned char)(v.ptr[i] - '\t') < 5))
+        i++;
+    return i;
+}
+
+// Reads the digits at v.ptr + i into out. Returns the index past them, or i
+// itself if there are none. overflow is set if the value does not fit
+static size_t cstr_parse_digits(cstr_view v, size_t i, uint64_t * out, bool * overflow)
+{
+    uint64_t x = 0;
+    *overflow = false;
+
+    for(; i < v.len && cstr_is_digit(v.ptr[i]); i++)
+    {
+        unsigned d = (unsigned)(v.ptr[i] - '0');
+        if(x > (UINT64_MAX - d) / 10)
+            *overflow = true;
+        x = x * 10 + d;
+    }
+
+    *out = x;
+    return i;
+}
+
+bool cstr_view_to_uint(cstr_view v, uint64_t * out, size_t * used)
+{
+    if(out == NULL || (v.ptr == NULL && v.len))
+        return false;
+
+    size_t i = cstr_skip_space(v);
+    if(i < v.len && v.ptr[i] == '+')
+        i++;
+
+    uint64_t x;
+    bool overflow;
+    size_t end = cstr_parse_digits(v, i, &x, &overflow);
+    if(end == i || overflow)
+        return false;
+
+    *out = x;
+    if(used != NULL)
+        *used = end;
+    return true;
+}
+
+bool cstr_view_to_int(cstr_view v, int64_t * out, size_t * used)
+{
+    if(out == NULL || (v.ptr == NULL && v.len))
+        return false;
+
+    size_t i = cstr_skip_space(v);
+    bool neg = i < v.len && v.ptr[i] == '-';
+    if(i < v.len && (v.ptr[i] == '+' || v.ptr[i] == '-'))
+        i++;
+
+    uint64_t x;
+    bool overflow;
+    size_t end = cstr_parse_digits(v, i, &x, &overflow);
+    if(end == i || overflow || x > (uint64_t)INT64_MAX + neg)
+        return false;
+
+    *out = neg ? (int64_t)(0 - x) : (int64_t)x;
+    if(used != NULL)
+        *used = end;
+    return true;
+}
+
+// Matches word case insensitively at v.ptr + i
+static bool cstr_match_word(cstr_view v, size_t i, const char * word, size_t len)
+{
+    if(v.len - i < len)
+        return false;
+    for(size_t j = 0; j < len; j++)
+        if((v.ptr[i + j] | 0x20) != word[j])
+            return false;
+    return true;
+}
+
+bool cstr_view_to_double(cstr_view v, double * out, size_t * used)
+{
+    static const double exact[23] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    if(out == NULL || (v.ptr == NULL && v.len))
+        return false;
+
+    size_t i = cstr_skip_space(v), start = i;
+    bool neg = i < v.len && v.ptr[i] == '-';
+    if(i < v.len && (v.ptr[i] == '+' || v.ptr[i] == '-'))
+        i++;
+
+    if(cstr_match_word(v, i, "inf", 3) || cstr_match_word(v, i, "nan", 3))
+    {
+        bool inf = (v.ptr[i] | 0x20) == 'i';
+        size_t end = i + (inf && cstr_match_word(v, i, "infinity", 8) ? 8 : 3);
+        *out = inf ? (neg ? -HUGE_VAL : HUGE_VAL) : (neg ? -NAN : NAN);
+        if(used != NULL)
+            *used = end;
+        return true;
+    }
+
+    // collects up to 19 significant digits, m * 10^exp10
+    uint64_t m = 0;
+    int sig = 0;
+    long exp10 = 0;
+    bool any = false, exact_m = true;
+
+    for(; i < v.len && cstr_is_digit(v.ptr[i]); i++)
+    {
+        any = true;
+        if(sig < 19)
+        {
+            m = m * 10 + (unsigned)(v.ptr[i] - '0');
+            sig += m != 0;
+        }
+        else
+        {
+            exp10++;
+            exact_m &= v.ptr[i] == '0';
+        }
+    }
+
+    if(i < v.len && v.ptr[i] == '.')
+    {
+        for(i++; i < v.len && cstr_is_digit(v.ptr[i]); i++)
+        {
+            any = true;
+            if(sig < 19)
+            {
+                m = m * 10 + (unsigned)(v.ptr[i] - '0');
+                sig += m != 0;
+                exp10--;
+            }
+            else
+                exact_m &= v.ptr[i] == '0';
+        }
+    }
+
+    if(!any)
+        return false;
+
+    // the exponent is only taken if it has digits
+    if(i < v.len && (v.ptr[i] | 0x20) == 'e')
+    {
+        size_t j = i + 1;
+        bool eneg = j < v.len && v.ptr[j] == '-';
+        if(j < v.len && (v.ptr[j] == '+' || v.ptr[j] == '-'))
+            j++;
+
+        if(j < v.len && cstr_is_digit(v.ptr[j]))
+        {
+            long e = 0;
+            for(; j < v.len && cstr_is_digit(v.ptr[j]); j++)
+                if(e < 100000)
+                    e = e * 10 + (v.ptr[j] - '0');
+            exp10 += eneg ? -e : e;
+            i = j;
+        }
+    }
+
+    double d;
+    if(m == 0)
+        d = 0.0;
+    else if(exact_m && m <= (1ull << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+        // both operands are exact, so one correctly rounded operation is exact too
+        d = (double)m;
+        d = exp10 < 0 ? d / exact[-exp10] : d * exact[exp10];
+    }
+    else
+    {
+        // rare long or extreme inputs are left to the C library
+        char small[128];
+        size_t n = i - start;
+        char * tmp = n < sizeof(small) ? small : malloc(n + 1);
+        if(tmp == NULL)
+            return false;
+
+        memcpy(tmp, v.ptr + start, n);
+        tmp[n] = '\0';
+        d = strtod(tmp, NULL);
+        if(tmp != small)
+            free(tmp);
+        neg = false;
+    }
+
+    *out = neg ? -d : d;
+    if(used != NULL)
+        *used = i;
+    return true;
+}
+
+const bool cstr_to_int(cstring * this, size_t pos, int64_t * out, size_t * end)
+{
+    size_t used;
+    if(this == NULL || pos > this->str->size ||
+       !cstr_view_to_int(cstr_view_n(this->str->val + pos, this->str->size - pos), out, &used))
+        return false;
+    if(end != NULL)
+        *end = pos + used;
+    return true;
+}
+
+const bool cstr_to_uint(cstring * this, size_t pos, uint64_t * out, size_t * end)
+{
+    size_t used;
+    if(this == NULL || pos > this->str->size ||
+       !cstr_view_to_uint(cstr_view_n(this->str->val + pos, this->str->size - pos), out, &used))
+        return false;
+    if(end != NULL)
+        *end = pos + used;
+    return true;
+}
+
+const bool cstr_to_double(cstring * this, size_t pos, double * out, size_t * end)
+{
+    size_t used;
+    if(this == NULL || pos > this->str->size ||
+       !cstr_view_to_double(cstr_view_n(this->str->val + pos, this->str->size - pos), out, &used))
+        return false;
+    if(end != NULL)
+        *end = pos + used;
+    return true;
+}
+
+
+
+/// Capacity ///
+const size_t cstr_length(cstring * this)
+{
+    if(this == NULL)
+        return npos;
+    return this->str->size;
+}
+
+const size_t cstr_max_size(cstring * this)
+{
+    if(this == NULL)
+        return npos;
+    return LONG_MAX;
+}
+
+const size_t cstr_resize(cstring * this, size_t nsize)
+{
+    if(this == NULL)
+        return npos;
+    if(nsize > 0 && nsize < LONG_MAX && nsize != this->str->size)
+    {
+        if(!cstr_grow(this, nsize))
+            return npos;
+
+        // growing pads with null characters, shrinking keeps the capacity
+        if(nsize > this->str->size)
+            memset(this->str->val + this->str->size, 0, nsize - this->str->size);
+
+        this->str->size = nsize;
+        this->str->hash = 0;
+        this->str->val[nsize] = '\0';
+    }
+    else
+    {
+        nsize = npos;
+    }
+
+    return nsize;
+}
+
+const void   cstr_clear(cstring * this)
+{
+    if(this == NULL)
+        return;
+    if(cstr_is_readonly(this))
+    {
+        cstr_detach(this, "", 0, 0);
+        return;
+    }
+    this->str->size = 0;
+    this->str->hash = 0;
+    this->str->val[0] = '\0';
+}
+
+const bool   cstr_empty(cstring * this)
+{
+    if(this == NULL)
+        return false;
+    return this->str->size == 0;
+}
+
+const void   cstr_shrink_to_fit(cstring * this)
+{
+    if(this == NULL)
+        return;
+
+    // a shared or mapped block has no spare capacity of this string's own
+    if(cstr_is_readonly(this) || this->str->capacity == this->str->size)
+        return;
+
+    // only the capacity changes, the characters and the cached hash are kept
+    cstr_realloc(this, this->str->size);
+}
+
+const size_t cstr_capacity(cstring * this)
+{
+    if(this == NULL)
+        return npos;
+    return this->str->capacity;
+}
+
+const void   cstr_reserve(cstring * this, size_t n)
+{
+    if(this == NULL || n <= this->str->capacity || n >= LONG_MAX)
+        return;
+
+    // reserves exactly what was asked for, only appends grow geometrically
+    cstr_realloc(this, n);
+}
+
+/// Iterators ///
+cstr_iterator cstr_begin(cstring * this)
+{
+    if(this == NULL)
+        return (cstr_iterator)ITR_END;
+    cstr_iterator itr = cstr_itr(ITR_BI_DIRECTIONAL);
+    itr->set(itr,&this->str->val[0]);
+    return itr;
+}
+
+cstr_iterator cstr_rbegin(cstring * this)
+{
+    if(this == NULL)
+        return (cstr_iterator)ITR_END;
+    cstr_iterator itr = cstr_itr(ITR_R_BI_DIRECTIONAL);
+    this->str->size != 0 ? (itr->set(itr,&this->str->val[this->str->size-1]))
+                         : (itr->set(itr,&this->str->val[0]));
+    return itr;
+}
+
+cstr_iterator cstr_end(cstring * this)
+{
+    (void)this;
+    return (cstr_iterator)ITR_END;
+}
+
+cstr_iterator cstr_rend(cstring * this)
+{
+    (void)this;
+    return (cstr_iterator)ITR_END;
+}
+
+cstr_it cstr_itr_begin(cstring * this)
+{
+    cstr_it it = { this == NULL ? NULL : this->str->val, 1 };
+    return it;
+}
+
+cstr_it cstr_itr_end(cstring * this)
+{
+    cstr_it it = { this == NULL ? NULL : this->str->val + this->str->size, 1 };
+    return it;
+}
+
+cstr_it cstr_itr_rbegin(cstring * this)
+{
+    cstr_it it = { this == NULL ? NULL : this->str->val + this->str->size, -1 };
+    return it;
+}
+
+cstr_it cstr_itr_rend(cstring * this)
+{
+    cstr_it it = { this == NULL ? NULL : this->str->val, -1 };
+    return it;
+}
+
+
+/// CSTR_VIEW Functions ///
+
+cstr_view cstr_view_from(const char * str)
+{
+    return cstr_view_n(str == NULL ? "" : str, str == NULL ? 0 : strlen(str));
+}
+
+cstr_view cstr_view_n(const char * ptr, size_t len)
+{
+    cstr_view v = { ptr, len };
+    return v;
+}
+
+size_t cstr_view_find(cstr_view v, cstr_view needle, size_t pos)
+{
+    return cstr_scan(v.ptr, v.len, needle.ptr, needle.len, pos);
+}
+
+bool cstr_view_compare(cstr_view v, cstr_view other)
+{
+    return v.len == other.len && (v.len == 0 || memcmp(v.ptr, other.ptr, v.len) == 0);
+}
+
+cstr_view cstr_view_substr(cstr_view v, size_t pos, size_t len)
+{
+    if(pos > v.len)
+        pos = v.len;
+    if(len > v.len - pos)
+        len = v.len - pos;
+    return cstr_view_n(v.ptr + pos, len);
+}
+
+bool cstr_view_starts_with(cstr_view v, cstr_view prefix)
+{
+    return prefix.len <= v.len && (prefix.len == 0 || memcmp(v.ptr, prefix.ptr, prefix.len) == 0);
+}
+
+bool cstr_view_ends_with(cstr_view v, cstr_view suffix)
+{
+    return suffix.len <= v.len
+           && (suffix.len == 0 || memcmp(v.ptr + v.len - suffix.len, suffix.ptr, suffix.len) == 0);
+}
+
+uint64_t cstr_view_hash(cstr_view v)
+{
+    return v.ptr == NULL ? cstr_wyhash("", 0) : cstr_wyhash(v.ptr, v.len);
+}
+
+
+/// CSTR_CHARSET Functions ///
+
+cstr_charset cstr_charset_of(const char * chars)
+{
+    return cstr_charset_n(chars, chars == NULL ? 0 : strlen(chars));
+}
+
+cstr_charset cstr_charset_n(const char * chars, size_t len)
+{
+    cstr_charset set;
+    memset(&set, 0, sizeof(set));
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = chars[i];
+        set.bits[c >> 6] |= 1ull << (c & 63);
+        set.lo[c >> 7][c & 15] |= 1 << ((c >> 4) & 7);
+    }
+
+    return set;
+}
+
+bool cstr_charset_has(const cstr_charset * set, char c)
+{
+    return set != NULL && cstr_in_set(set, c);
+}
+
+
+/// CSTR_PATTERN Functions ///
+
+// Splits the needle into two parts for the Two-Way search and stores the
+// period of the right hand part, the split lies at the shorter of the
+// maximal suffixes for the two opposite orderings of the alphabet
+static size_t cstr_critical_factorization(const unsigned char * n, size_t nlen, size_t * period)
+{
+    size_t max_suffix, max_suffix_rev, j, k, p;
+
+    // the max_suffix + k index deliberately wraps from SIZE_MAX to k - 1
+    max_suffix = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+    while(j + k < nlen)
+    {
+        unsigned char a = n[j + k], b = n[max_suffix + k];
+        if(a < b)
+        {
+            j += k;
+            k = 1;
+            p = j - max_suffix;
+        }
+        else if(a == b)
+        {
+            if(k != p)
+                ++k;
+            else
+            {
+                j += p;
+                k = 1;
+            }
+        }
+        else
+        {
+            max_suffix = j++;
+            k = p = 1;
+        }
+    }
+    *period = p;
+
+    max_suffix_rev = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+    while(j + k < nlen)
+    {
+        unsigned char a = n[j + k], b = n[max_suffix_rev + k];
+        if(b < a)
+        {
+            j += k;
+            k = 1;
+            p = j - max_suffix_rev;
+        }
+        else if(a == b)
+        {
+            if(k != p)
+                ++k;
+            else
+            {
+                j += p;
+                k = 1;
+            }
+        }
+        else
+        {
+            max_suffix_rev = j++;
+            k = p = 1;
+        }
+    }
+
+    if(max_suffix_rev + 1 < max_suffix + 1)
+        return max_suffix + 1;
+    *period = p;
+    return max_suffix_rev + 1;
+}
+
+cstr_pattern cstr_pattern_new(const char * needle)
+{
+    return cstr_pattern_n(needle, needle == NULL ? 0 : strlen(needle));
+}
+
+cstr_pattern cstr_pattern_n(const char * needle, size_t len)
+{
+    if(needle == NULL || len == 0)
+        return NULL;
+
+    cstr_pattern pat = malloc(sizeof(struct _cstr_pattern_) + len + CSTR_PAD);
+    if(pat == NULL)
+        return NULL;
+
+    const unsigned char * n = (const unsigned char *)needle;
+
+    pat->len = len;
+    memcpy(pat->val, needle, len);
+    pat->val[len] = '\0';
+
+    // bad character shifts, shared by Horspool and the Two-Way search
+    for(size_t i = 0; i < 256; ++i)
+        pat->shift[i] = len;
+    for(size_t i = 0; i + 1 < len; ++i)
+        pat->shift[n[i]] = len - i - 1;
+
+    pat->suffix = 0;
+    pat->period = 0;
+    pat->periodic = false;
+
+    if(len >= CSTR_PAT_TWO_WAY)
+    {
+        pat->suffix = cstr_critical_factorization(n, len, &pat->period);
+        pat->periodic = memcmp(n, n + pat->period, pat->suffix) == 0;
+        if(!pat->periodic)
+            pat->period = (pat->suffix > len - pat->suffix ? pat->suffix : len - pat->suffix) + 1;
+    }
+
+    return pat;
+}
+
+void cstr_pattern_delete(cstr_pattern pat)
+{
+    free(pat);
+}
+
+size_t cstr_pattern_length(cstr_pattern pat)
+{
+    return pat == NULL ? 0 : pat->len;
+}
+
+static size_t cstr_horspool(cstr_pattern pat, const unsigned char * h, size_t hlen)
+{
+    const unsigned char * n = (const unsigned char *)pat->val;
+    size_t nlen = pat->len;
+    unsigned char last = n[nlen - 1];
+
+    for(size_t j = 0; j + nlen <= hlen; )
+    {
+        unsigned char c = h[j + nlen - 1];
+        if(c == last && memcmp(h + j, n, nlen - 1) == 0)
+            return j;
+        j += pat->shift[c];
+    }
+
+    return npos;
+}
+
+static size_t cstr_two_way(cstr_pattern pat, const unsigned char * h, size_t hlen)
+{
+    const unsigned char * n = (const unsigned char *)pat->val;
+    size_t nlen = pat->len;
+    size_t suffix = pat->suffix;
+    size_t period = pat->period;
+    size_t i, j = 0;
+
+    // the shift table is built for Horspool and never shifts by 0, a window
+    // ending in the needle's last character must be compared instead
+    unsigned char last = n[nlen - 1];
+
+    if(pat->periodic)
+    {
+        // the left part is repeated in the right, remember how much of
+        // the needle is already known to match after a period shift
+        size_t memory = 0;
+        while(j + nlen <= hlen)
+        {
+            unsigned char c = h[j + nlen - 1];
+            size_t shift = c == last ? 0 : pat->shift[c];
+            if(shift > 0)
+            {
+                if(memory && shift < period)
+                    shift = nlen - period;
+                memory = 0;
+                j += shift;
+                continue;
+            }
+
+            i = suffix > memory ? suffix : memory;
+            while(i < nlen - 1 && n[i] == h[i + j])
+                ++i;
+            if(nlen - 1 <= i)
+            {
+                i = suffix - 1;
+                while(memory < i + 1 && n[i] == h[i + j])
+                    --i;
+                if(i + 1 < memory + 1)
+                    return j;
+                j += period;
+                memory = nlen - period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
+    }
+    else
+    {
+        while(j + nlen <= hlen)
+        {
+            unsigned char c = h[j + nlen - 1];
+            size_t shift = c == last ? 0 : pat->shift[c];
+            if(shift > 0)
+            {
+                j += shift;
+                continue;
+            }
+
+            i = suffix;
+            while(i < nlen - 1 && n[i] == h[i + j])
+                ++i;
+            if(nlen - 1 <= i)
+            {
+                i = suffix - 1;
+                while(i != SIZE_MAX && n[i] == h[i + j])
+                    --i;
+                if(i == SIZE_MAX)
+                    return j;
+                j += period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+            }
+        }
+    }
+
+    return npos;
+}
+
+size_t cstr_pattern_find(cstr_pattern pat, cstr_view v, size_t pos)
+{
+    if(pat == NULL || pat->len > v.len || pos > v.len - pat->len)
+        return npos;
+
+    if(pat->len < CSTR_PAT_HORSPOOL)
+        return cstr_scan(v.ptr, v.len, pat->val, pat->len, pos);
+
+    const unsigned char * h = (const unsigned char *)v.ptr + pos;
+    size_t ret = pat->len < CSTR_PAT_TWO_WAY ? cstr_horspool(pat, h, v.len - pos)
+                                             : cstr_two_way(pat, h, v.len - pos);
+    return ret == npos ? npos : ret + pos;
+}
+
+cstr_matches cstr_pattern_matches(cstr_pattern pat, cstr_view v, bool overlap)
+{
+    cstr_matches it = { pat, v, 0, overlap };
+    return it;
+}
+
+bool cstr_matches_next(cstr_matches * it, size_t * pos)
+{
+    if(it == NULL)
+        return false;
+
+    size_t ret = cstr_pattern_find(it->pat, it->hay, it->pos);
+    if(ret == npos)
+    {
+        it->pos = it->hay.len + 1;
+        return false;
+    }
+
+    it->pos = ret + (it->overlap ? 1 : it->pat->len);
+    if(pos != NULL)
+        *pos = ret;
+    return true;
+}
+
+
+/// CSTR_AUTOMATON Functions ///
+
+cstr_automaton cstr_automaton_new(const char * const * needles, size_t count)
+{
+    cstr_view * views = malloc((count ? count : 1) * sizeof(cstr_view));
+    if(views == NULL)
+        return NULL;
+
+    for(size_t i = 0; i < count; ++i)
+        views[i] = cstr_view_from(needles == NULL ? NULL : needles[i]);
+
+    cstr_automaton ac = cstr_automaton_n(views, count);
+    free(views);
+    return ac;
+}
+
+void cstr_automaton_delete(cstr_automaton ac)
+{
+    if(ac == NULL)
+        return;
+
+    free(ac->delta);
+    free(ac->first);
+    free(ac->link);
+    free(ac->next);
+    free(ac->len);
+    free(ac);
+}
+
+cstr_automaton cstr_automaton_n(const cstr_view * needles, size_t count)
+{
+    if(needles == NULL && count)
+        return NULL;
+
+    cstr_automaton ac = calloc(1, sizeof(struct _cstr_automaton_));
+    if(ac == NULL)
+        return NULL;
+
+    // columns are handed out to characters in order of first use,
+    // column 0 stands for every character no needle contains
+    size_t total = 1;
+    ac->classes = 1;
+    ac->count = count;
+    for(size_t i = 0; i < count; ++i)
+    {
+        for(size_t j = 0; j < needles[i].len; ++j)
+        {
+            unsigned char c = needles[i].ptr[j];
+            if(ac->cls[c] == 0)
+                ac->cls[c] = ac->classes++;
+        }
+        total += needles[i].len;
+    }
+
+    ac->delta = calloc(total * ac->classes, sizeof(uint32_t));
+    ac->first = malloc(total * sizeof(uint32_t));
+    ac->link  = malloc(total * sizeof(uint32_t));
+    ac->next  = malloc((count ? count : 1) * sizeof(uint32_t));
+    ac->len   = malloc((count ? count : 1) * sizeof(size_t));
+    uint32_t * fail  = malloc(total * sizeof(uint32_t));
+    uint32_t * queue = malloc(total * sizeof(uint32_t));
+
+    if(ac->delta == NULL || ac->first == NULL || ac->link == NULL || ac->next == NULL
+       || ac->len == NULL || fail == NULL || queue == NULL || total > CSTR_AC_NONE)
+    {
+        free(fail);
+        free(queue);
+        cstr_automaton_delete(ac);
+        return NULL;
+    }
+
+    // builds the trie, a zero transition means no child yet as
+    // the root can never be a child
+    ac->states = 1;
+    ac->first[0] = CSTR_AC_NONE;
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint32_t s = 0;
+        ac->len[i] = needles[i].len;
+        ac->next[i] = CSTR_AC_NONE;
+        if(needles[i].len == 0)
+            continue;
+
+        for(size_t j = 0; j < needles[i].len; ++j)
+        {
+            uint32_t * t = &ac->delta[s * ac->classes + ac->cls[(unsigned char)needles[i].ptr[j]]];
+            if(*t == 0)
+            {
+                *t = ac->states;
+                ac->first[ac->states++] = CSTR_AC_NONE;
+            }
+            s = *t;
+        }
+
+        // needles with the same characters share a state, keep them in order
+        uint32_t * id = &ac->first[s];
+        while(*id != CSTR_AC_NONE)
+            id = &ac->next[*id];
+        *id = i;
+    }
+
+    // breadth first over the trie, each state's failure link is complete
+    // before its children are visited so missing transitions can be copied
+    // from the failure state's row
+    size_t head = 0, tail = 0;
+    fail[0] = 0;
+    ac->link[0] = CSTR_AC_NONE;
+    queue[tail++] = 0;
+    while(head < tail)
+    {
+        uint32_t s = queue[head++];
+        uint32_t * row = &ac->delta[s * ac->classes];
+        uint32_t * frow = &ac->delta[fail[s] * ac->classes];
+
+        for(size_t c = 0; c < ac->classes; ++c)
+        {
+            uint32_t t = row[c];
+            if(t == 0)
+            {
+                row[c] = s == 0 ? 0 : frow[c];
+                continue;
+            }
+
+            uint32_t f = s == 0 ? 0 : frow[c];
+            fail[t] = f;
+            ac->link[t] = ac->first[f] != CSTR_AC_NONE ? f : ac->link[f];
+            queue[tail++] = t;
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    // gives back the rows reserved for states the trie did not need
+    uint32_t * delta = realloc(ac->delta, ac->states * ac->classes * sizeof(uint32_t));
+    if(delta != NULL)
+        ac->delta = delta;
+
+    return ac;
+}
+
+size_t cstr_automaton_each(cstr_automaton ac, cstr_view v,
+                           bool (*fn)(void * ctx, cstr_hit hit), void * ctx)
+{
+    if(ac == NULL || fn == NULL)
+        return 0;
+
+    const unsigned char * h = (const unsigned char *)v.ptr;
+    const uint32_t * delta = ac->delta;
+    size_t classes = ac->classes;
+    size_t calls = 0;
+    uint32_t s = 0;
+
+    for(size_t i = 0; i < v.len; ++i)
+    {
+        s = delta[s * classes + ac->cls[h[i]]];
+
+        uint32_t t = ac->first[s] != CSTR_AC_NONE ? s : ac->link[s];
+        for( ; t != CSTR_AC_NONE; t = ac->link[t])
+        {
+            for(uint32_t id = ac->first[t]; id != CSTR_AC_NONE; id = ac->next[id])
+            {
+                cstr_hit hit = { id, i + 1 - ac->len[id] };
+                ++calls;
+                if(!fn(ctx, hit))
+                    return calls;
+            }
+        }
+    }
+
+    return calls;
+}
+
+// collects hits for cstr_automaton_scan
+struct _cstr_hits_
+{
+    cstr_hit * out;
+    size_t     max;
+    size_t     count;
+};
+
+static bool cstr_collect_hit(void * ctx, cstr_hit hit)
+{
+    struct _cstr_hits_ * hits = ctx;
+    if(hits->count < hits->max)
+        hits->out[hits->count] = hit;
+    ++hits->count;
+    return true;
+}
+
+size_t cstr_automaton_scan(cstr_automaton ac, cstr_view v, cstr_hit * out, size_t max)
+{
+    struct _cstr_hits_ hits = { out, max, 0 };
+    return cstr_automaton_each(ac, v, &cstr_collect_hit, &hits);
+}
+
+
+/// CSTR_SPLIT Functions ///
+
+static cstr_split cstr_split_init(cstr_view v, size_t max, bool collapse)
+{
+    cstr_split it;
+    memset(&it, 0, sizeof(it));
+
+    it.hay = v;
+    it.delim = cstr_view_n("", 0);
+    it.chr = -1;
+    it.max = max;
+    it.collapse = collapse;
+    return it;
+}
+
+cstr_split cstr_split_on_char(cstr_view v, char delim, size_t max, bool collapse)
+{
+    cstr_split it = cstr_split_init(v, max, collapse);
+    it.chr = (unsigned char)delim;
+    return it;
+}
+
+cstr_split cstr_split_on(cstr_view v, const cstr_charset * set, size_t max, bool collapse)
+{
+    cstr_split it = cstr_split_init(v, max, collapse);
+    if(set != NULL)
+        it.set = *set;
+    return it;
+}
+
+cstr_split cstr_split_on_str(cstr_view v, cstr_view delim, size_t max, bool collapse)
+{
+    cstr_split it = cstr_split_init(v, max, collapse);
+
+    // with nothing to split on the whole string is the only token
+    if(delim.ptr == NULL || delim.len == 0)
+        it.max = 1;
+    else
+        it.delim = delim;
+    return it;
+}
+
+// Finds the next delimiter at or after pos, storing its length in len
+static size_t cstr_split_find(const cstr_split * it, size_t pos, size_t * len)
+{
+    const cstr_view h = it->hay;
+    *len = it->delim.len ? it->delim.len : 1;
+
+    if(pos >= h.len)
+        return npos;
+
+    if(it->chr >= 0)
+    {
+        const char * p = memchr(h.ptr + pos, it->chr, h.len - pos);
+        return p == NULL ? npos : (size_t)(p - h.ptr);
+    }
+
+    if(it->delim.len)
+        return cstr_scan(h.ptr, h.len, it->delim.ptr, it->delim.len, pos);
+
+    return cstr_span_impl(h.ptr, h.len, &it->set, pos, true);
+}
+
+bool cstr_split_next(cstr_split * it, cstr_token * tok)
+{
+    if(it == NULL || it->hay.len < it->pos)
+        return false;
+
+    size_t start = it->pos, end, dlen;
+
+    // the last allowed token takes the rest of the string
+    if(it->max == 1 && !it->collapse)
+        end = npos;
+    else
+        for(;;)
+        {
+            end = cstr_split_find(it, start, &dlen);
+            if(!it->collapse || end != start)
+                break;
+            start += dlen;
+        }
+
+    if(it->max == 1)
+        end = npos;
+
+    if(end == npos)
+    {
+        end = it->hay.len;
+        it->pos = end + 1;
+
+        // a collapsed split has no token after a trailing delimiter
+        if(it->collapse && end == start)
+            return false;
+    }
+    else
+        it->pos = end + dlen;
+
+    if(it->max > 1)
+        it->max--;
+
+    if(tok != NULL)
+    {
+        tok->pos = start;
+        tok->len = end - start;
+    }
+    return true;
+}
+
+size_t cstr_split_all(cstr_split * it, cstr_token * out, size_t max)
+{
+    size_t n = 0;
+    while(n < max && cstr_split_next(it, out + n))
+        n++;
+    return n;
+}
+
+cstr_view cstr_token_view(cstr_view v, cstr_token tok)
+{
+    return cstr_view_substr(v, tok.pos, tok.len);
+}
+
+
+/// CSTR_STREAM Functions ///
+
+struct _cstr_stream_
+{
+    cstring *    buf;       // the unsearched tail of the last chunk followed by the current one
+    cstr_pattern pat;
+    FILE *       file;      // read from when not NULL, otherwise fd
+    int          fd;
+    size_t       chunk;
+    uint64_t     base;      // stream offset of the first character in buf
+    size_t       pos;       // where the next search in buf begins
+    bool         eof;
+    bool         error;
+};
+
+static cstr_stream cstr_stream_new(FILE * file, int fd, cstr_pattern pat, size_t chunk)
+{
+    if(pat == NULL)
+        return NULL;
+
+    cstr_stream s = malloc(sizeof(struct _cstr_stream_));
+    if(s == NULL)
+        return NULL;
+
+    s->chunk = chunk ? chunk : CSTR_STREAM_CHUNK;
+    s->buf = string_n("", 0);
+    s->pat = pat;
+    s->file = file;
+    s->fd = fd;
+    s->base = 0;
+    s->pos = 0;
+    s->eof = false;
+    s->error = false;
+
+    // the buffer never needs more than a chunk plus the kept overlap
+    if(s->buf != NULL)
+        cstr_reserve(s->buf, s->chunk + pat->len);
+    if(s->buf == NULL || s->buf->str->capacity < s->chunk + pat->len)
+    {
+        delete_string(s->buf);
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+cstr_stream cstr_stream_fd(int fd, cstr_pattern pat, size_t chunk)
+{
+#if CSTR_POSIX
+    return fd < 0 ? NULL : cstr_stream_new(NULL, fd, pat, chunk);
+#else
+    (void)fd;
+    (void)pat;
+    (void)chunk;
+    return NULL;
+#endif
+}
+
+cstr_stream cstr_stream_file(FILE * file, cstr_pattern pat, size_t chunk)
+{
+    return file == NULL ? NULL : cstr_stream_new(file, -1, pat, chunk);
+}
+
+// Reads the next chunk onto the end of the buffer, returns false at the end of the input
+static bool cstr_stream_fill(cstr_stream s)
+{
+    cstr b = s->buf->str;
+    size_t n = 0;
+
+    if(s->file != NULL)
+    {
+        n = fread(b->val + b->size, 1, s->chunk, s->file);
+        if(n == 0 && ferror(s->file))
+            s->error = true;
+    }
+#if CSTR_POSIX
+    else
+    {
+        ssize_t r;
+        do
+            r = read(s->fd, b->val + b->size, s->chunk);
+        while(r < 0 && errno == EINTR);
+
+        if(r < 0)
+            s->error = true;
+        else
+            n = (size_t)r;
+    }
+#endif
+
+    if(n == 0)
+    {
+        s->eof = true;
+        return false;
+    }
+
+    b->size += n;
+    b->hash = 0;
+    b->val[b->size] = '\0';
+    return true;
+}
+
+bool cstr_stream_next(cstr_stream s, uint64_t * offset)
+{
+    if(s == NULL)
+        return false;
+
+    for(;;)
+    {
+        cstr b = s->buf->str;
+        size_t ret = cstr_pattern_find(s->pat, cstr_view_n(b->val, b->size), s->pos);
+
+        if(ret != npos)
+        {
+            s->pos = ret + s->pat->len;
+            if(offset != NULL)
+                *offset = s->base + ret;
+            return true;
+        }
+
+        if(s->eof)
+            return false;
+
+        // only the last len - 1 characters can begin an occurrence that
+        // ends in the next chunk, and nothing before pos is searched again
+        size_t keep = s->pat->len - 1;
+        size_t drop = b->size > keep ? b->size - keep : 0;
+        if(drop < s->pos)
+            drop = s->pos;
+
+        memmove(b->val, b->val + drop, b->size - drop);
+        b->size -= drop;
+        b->hash = 0;
+        s->base += drop;
+        s->pos = 0;
+
+        if(!cstr_stream_fill(s))
+            return false;
+    }
+}
+
+bool cstr_stream_error(cstr_stream s)
+{
+    return s != NULL && s->error;
+}
+
+void cstr_stream_delete(cstr_stream s)
+{
+    if(s == NULL)
+        return;
+    delete_string(s->buf);
+    free(s);
+}
+
+
+/// CSTR_POOL Functions ///
+
+// an open addressing table of interned strings probed linearly from their
+// hash. Slots are only ever filled, so a reader can probe without a lock
+struct _cstr_pool_table_
+{
+    struct _cstr_pool_table_ * retired;   // older tables readers may still be probing
+    size_t mask;                            // slot count - 1, a power of two
+    _Atomic(cstring *) slot[];
+};
+
+struct _cstr_pool_
+{
+    _Atomic(struct _cstr_pool_table_ *) table;
+    size_t count;
+#if CSTR_POSIX
+    pthread_mutex_t lock;
+#else
+    atomic_flag lock;
+#endif
+};
+
+#define CSTR_POOL_MIN     64
+
+static void cstr_pool_lock(cstr_pool pool)
+{
+#if CSTR_POSIX
+    pthread_mutex_lock(&pool->lock);
+#else
+    while(atomic_flag_test_and_set_explicit(&pool->lock, memory_order_acquire))
+        ;
+#endif
+}
+
+static void cstr_pool_unlock(cstr_pool pool)
+{
+#if CSTR_POSIX
+    pthread_mutex_unlock(&pool->lock);
+#else
+    atomic_flag_clear_explicit(&pool->lock, memory_order_release);
+#endif
+}
+
+static struct _cstr_pool_table_ * cstr_pool_table(size_t slots)
+{
+    struct _cstr_pool_table_ * t = malloc(sizeof(struct _cstr_pool_table_) + slots * sizeof(t->slot[0]));
+    if(t == NULL)
+        return NULL;
+
+    t->retired = NULL;
+    t->mask = slots - 1;
+    for(size_t i = 0; i < slots; i++)
+        atomic_init(&t->slot[i], NULL);
+    return t;
+}
+
+cstr_pool cstr_pool_new(void)
+{
+    cstr_pool pool = malloc(sizeof(struct _cstr_pool_));
+    struct _cstr_pool_table_ * t = cstr_pool_table(CSTR_POOL_MIN);
+    if(pool == NULL || t == NULL)
+    {
+        free(pool);
+        free(t);
+        return NULL;
+    }
+
+    atomic_init(&pool->table, t);
+    pool->count = 0;
+#if CSTR_POSIX
+    pthread_mutex_init(&pool->lock, NULL);
+#else
+    atomic_flag_clear(&pool->lock);
+#endif
+    return pool;
+}
+
+void cstr_pool_delete(cstr_pool pool)
+{
+    if(pool == NULL)
+        return;
+
+    struct _cstr_pool_table_ * t = atomic_load(&pool->table);
+    for(size_t i = 0; i <= t->mask; i++)
+        delete_string(atomic_load_explicit(&t->slot[i], memory_order_relaxed));
+
+    while(t != NULL)
+    {
+        struct _cstr_pool_table_ * next = t->retired;
+        free(t);
+        t = next;
+    }
+
+#if CSTR_POSIX
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    free(pool);
+}
+
+// Probes t for the contents of v, returning the slot that holds it or the
+// empty slot where it belongs
+static size_t cstr_pool_probe(struct _cstr_pool_table_ * t, cstr_view v, uint64_t hash, cstring ** found)
+{
+    size_t i = (size_t)hash & t->mask;
+
+    // the hash is cached in every interned string before it is published,
+    // so it is compared before any characters are
+    for(;; i = (i + 1) & t->mask)
+    {
+        cstring * s = atomic_load_explicit(&t->slot[i], memory_order_acquire);
+        if(s == NULL || (s->str->hash == hash && s->str->size == v.len
+                         && (v.len == 0 || memcmp(s->str->val, v.ptr, v.len) == 0)))
+        {
+            *found = s;
+            return i;
+        }
+    }
+}
+
+// Moves every string into a table twice the size and publishes it. The old
+// table is kept until the pool is deleted as readers may still be in it
+static bool cstr_pool_grow(cstr_pool pool)
+{
+    struct _cstr_pool_table_ * old = atomic_load_explicit(&pool->table, memory_order_relaxed);
+    struct _cstr_pool_table_ * t = cstr_pool_table((old->mask + 1) * 2);
+    if(t == NULL)
+        return false;
+
+    for(size_t i = 0; i <= old->mask; i++)
+    {
+        cstring * s = atomic_load_explicit(&old->slot[i], memory_order_relaxed);
+        if(s == NULL)
+            continue;
+
+        size_t j = (size_t)s->str->hash & t->mask;
+        while(atomic_load_explicit(&t->slot[j], memory_order_relaxed) != NULL)
+            j = (j + 1) & t->mask;
+        atomic_store_explicit(&t->slot[j], s, memory_order_relaxed);
+    }
+
+    t->retired = old;
+    atomic_store_explicit(&pool->table, t, memory_order_release);
+    return true;
+}
+
+static cstring * cstr_intern_hashed(cstr_pool pool, cstr_view v, uint64_t hash)
+{
+    cstring * s;
+
+    // fast path, the string is usually interned already
+    cstr_pool_probe(atomic_load_explicit(&pool->table, memory_order_acquire), v, hash, &s);
+    if(s != NULL)
+        return s;
+
+    cstr_pool_lock(pool);
+
+    // another thread may have added it or grown the table since
+    struct _cstr_pool_table_ * t = atomic_load_explicit(&pool->table, memory_order_relaxed);
+    size_t i = cstr_pool_probe(t, v, hash, &s);
+
+    if(s == NULL && (pool->count + 1) * 2 > t->mask + 1)
+    {
+        if(cstr_pool_grow(pool))
+        {
+            t = atomic_load_explicit(&pool->table, memory_order_relaxed);
+            i = cstr_pool_probe(t, v, hash, &s);
+        }
+        else
+            t = NULL;
+    }
+
+    if(s == NULL && t != NULL)
+    {
+        s = string_n(v.ptr, v.len);
+        if(s != NULL)
+        {
+            s->str->hash = hash;
+            pool->count++;
+            atomic_store_explicit(&t->slot[i], s, memory_order_release);
+        }
+    }
+
+    cstr_pool_unlock(pool);
+    return s;
+}
+
+cstring * cstr_intern(cstr_pool pool, const char * str)
+{
+    return str == NULL ? NULL : cstr_intern_n(pool, str, strlen(str));
+}
+
+cstring * cstr_intern_n(cstr_pool pool, const char * str, size_t len)
+{
+    return cstr_intern_view(pool, cstr_view_n(str, len));
+}
+
+cstring * cstr_intern_view(cstr_pool pool, cstr_view v)
+{
+    if(pool == NULL || (v.ptr == NULL && v.len))
+        return NULL;
+    return cstr_intern_hashed(pool, v, cstr_view_hash(v));
+}
+
+cstring * cstr_intern_string(cstr_pool pool, cstring * str)
+{
+    if(pool == NULL || str == NULL)
+        return NULL;
+
+    // reuses the hash the string may already have cached
+    return cstr_intern_hashed(pool, cstr_view_of(str), cstr_hash(str));
+}
+
+cstring * cstr_pool_lookup(cstr_pool pool, cstr_view v)
+{
+    if(pool == NULL || (v.ptr == NULL && v.len))
+        return NULL;
+
+    cstring * s;
+    cstr_pool_probe(atomic_load_explicit(&pool->table, memory_order_acquire), v, cstr_view_hash(v), &s);
+    return s;
+}
+
+size_t cstr_pool_size(cstr_pool pool)
+{
+    if(pool == NULL)
+        return 0;
+
+    cstr_pool_lock(pool);
+    size_t n = pool->count;
+    cstr_pool_unlock(pool);
+    return n;
+}
+
+
+/// CSTR_MAP Functions ///
+
+#define CSTR_MAP_GROUP      16
+#define CSTR_MAP_EMPTY      ((int8_t)-128)
+#define CSTR_MAP_DELETED    ((int8_t)-2)
+
+struct _cstr_map_slot_
+{
+    uint64_t  hash;     // full hash of the key, compared before its characters
+    cstring * key;
+    void *    val;
+};
+
+struct _cstr_map_
+{
+    int8_t * ctrl;      // per slot, empty, deleted or the low 7 bits of the hash
+    struct _cstr_map_slot_ * slots;
+    size_t   mask;      // group count - 1, a power of two
+    size_t   size;      // full slots
+    size_t   used;      // full and deleted slots, at least one group always keeps an empty one
+    cstr_arena keys;    // every key is allocated here
+    size_t   live;      // arena bytes held by keys in the map
+    size_t   dead;      // arena bytes of removed keys, reclaimed by cstr_map_compact
+};
+
+// arena bytes taken by a key of len characters
+static size_t cstr_map_key_bytes(size_t len)
+{
+    return sizeof(struct _cstring_) + (len > CSTR_SSO_CAPACITY ? CSTR_BLOCK(len) : 0);
+}
+
+// Bit i is set for every control byte in the group equal to c
+static inline unsigned cstr_map_match(const int8_t * g, int8_t c)
+{
+#if CSTR_SIMD
+    __m128i v = _mm_loadu_si128((const __m128i *)g);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+#else
+    unsigned m = 0;
+    for(int i = 0; i < CSTR_MAP_GROUP; i++)
+        m |= (unsigned)(g[i] == c) << i;
+    return m;
+#endif
+}
+
+// Bit i is set for every empty or deleted slot in the group
+static inline unsigned cstr_map_free_slots(const int8_t * g)
+{
+#if CSTR_SIMD
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+    unsigned m = 0;
+    for(int i = 0; i < CSTR_MAP_GROUP; i++)
+        m |= (unsigned)(g[i] < 0) << i;
+    return m;
+#endif
+}
+
+static inline unsigned cstr_map_ctz(unsigned bits)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(bits);
+#else
+    unsigned n = 0;
+    while(!(bits & 1))
+    {
+        bits >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Allocates the control bytes and slots for groups groups, all empty
+static bool cstr_map_alloc(cstr_map m, size_t groups)
+{
+    size_t n = groups * CSTR_MAP_GROUP;
+    int8_t * ctrl = malloc(n + n * sizeof(struct _cstr_map_slot_));
+    if(ctrl == NULL)
+        return false;
+
+    memset(ctrl, CSTR_MAP_EMPTY, n);
+    m->ctrl = ctrl;
+    m->slots = (struct _cstr_map_slot_ *)(ctrl + n);
+    m->mask = groups - 1;
+    return true;
+}
+
+cstr_map cstr_map_new(size_t cap)
+{
+    cstr_map m = malloc(sizeof(struct _cstr_map_));
+    if(m == NULL)
+        return NULL;
+
+    // keeps the load under 7/8
+    size_t groups = 1;
+    while(groups * CSTR_MAP_GROUP * 7 / 8 < cap)
+        groups *= 2;
+
+    m->size = 0;
+    m->used = 0;
+    m->live = 0;
+    m->dead = 0;
+    m->keys = cstr_arena_new(4096);
+    if(m->keys == NULL || !cstr_map_alloc(m, groups))
+    {
+        cstr_arena_delete(m->keys);
+        free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+void cstr_map_delete(cstr_map m)
+{
+    if(m == NULL)
+        return;
+
+    // the keys all go with the arena
+    cstr_arena_delete(m->keys);
+    free(m->ctrl);
+    free(m);
+}
+
+size_t cstr_map_size(cstr_map m)
+{
+    return m == NULL ? 0 : m->size;
+}
+
+// Returns the slot holding key, or NULL. Groups are visited in triangular
+// order, which reaches every group, until one with an empty slot is seen
+static struct _cstr_map_slot_ * cstr_map_seek(cstr_map m, cstr_view key, uint64_t hash)
+{
+    int8_t h2 = (int8_t)(hash & 0x7F);
+    size_t g = (size_t)(hash >> 7) & m->mask;
+
+    for(size_t step = 1; ; g = (g + step++) & m->mask)
+    {
+        const int8_t * c = m->ctrl + g * CSTR_MAP_GROUP;
+
+        for(unsigned bits = cstr_map_match(c, h2); bits; bits &= bits - 1)
+        {
+            struct _cstr_map_slot_ * s = &m->slots[g * CSTR_MAP_GROUP + cstr_map_ctz(bits)];
+            if(s->hash == hash && s->key->str->size == key.len
+               && (key.len == 0 || memcmp(s->key->str->val, key.ptr, key.len) == 0))
+                return s;
+        }
+
+        if(cstr_map_match(c, CSTR_MAP_EMPTY))
+            return NULL;
+    }
+}
+
+// Returns the index of the first empty or deleted slot on the probe path of hash
+static size_t cstr_map_free_slot(cstr_map m, uint64_t hash)
+{
+    size_t g = (size_t)(hash >> 7) & m->mask;
+
+    for(size_t step = 1; ; g = (g + step++) & m->mask)
+    {
+        unsigned bits = cstr_map_free_slots(m->ctrl + g * CSTR_MAP_GROUP);
+        if(bits)
+            return g * CSTR_MAP_GROUP + cstr_map_ctz(bits);
+    }
+}
+
+// Moves every entry into a table sized for twice the current entries,
+// dropping deleted slots on the way
+static bool cstr_map_rehash(cstr_map m)
+{
+    struct _cstr_map_ old = *m;
+    size_t groups = 1;
+    while(groups * CSTR_MAP_GROUP * 7 / 16 < m->size + 1)
+        groups *= 2;
+
+    if(!cstr_map_alloc(m, groups))
+        return false;
+
+    for(size_t i = 0; i < (old.mask + 1) * CSTR_MAP_GROUP; i++)
+    {
+        if(old.ctrl[i] < 0)
+            continue;
+
+        size_t j = cstr_map_free_slot(m, old.slots[i].hash);
+        m->ctrl[j] = old.ctrl[i];
+        m->slots[j] = old.slots[i];
+    }
+
+    m->used = m->size;
+    free(old.ctrl);
+    return true;
+}
+
+static bool cstr_map_insert(cstr_map m, cstr_view key, uint64_t hash, void * val)
+{
+    struct _cstr_map_slot_ * s = cstr_map_seek(m, key, hash);
+    if(s != NULL)
+    {
+        s->val = val;
+        return true;
+    }
+
+    if((m->used + 1) * 8 > (m->mask + 1) * CSTR_MAP_GROUP * 7 && !cstr_map_rehash(m))
+        return false;
+
+    cstring * k = string_alloc(key.ptr, key.len, cstr_arena_allocator(m->keys));
+    if(k == NULL)
+        return false;
+    k->str->hash = hash;
+
+    size_t i = cstr_map_free_slot(m, hash);
+    if(m->ctrl[i] == CSTR_MAP_EMPTY)
+        m->used++;
+
+    m->ctrl[i] = (int8_t)(hash & 0x7F);
+    m->slots[i].hash = hash;
+    m->slots[i].key = k;
+    m->slots[i].val = val;
+    m->size++;
+    m->live += cstr_map_key_bytes(key.len);
+    return true;
+}
+
+// Copies the keys still in the map into a fresh arena and drops the old one,
+// so removing keys cannot grow the arena without bound. Nothing changes if
+// the copies cannot be allocated
+static void cstr_map_compact(cstr_map m)
+{
+    size_t n = (m->mask + 1) * CSTR_MAP_GROUP;
+    cstr_arena keys = cstr_arena_new(4096);
+    cstring ** copy = malloc(n * sizeof(cstring *));
+    bool ok = keys != NULL && copy != NULL;
+
+    for(size_t i = 0; ok && i < n; i++)
+    {
+        if(m->ctrl[i] < 0)
+            continue;
+
+        cstring * k = m->slots[i].key;
+        copy[i] = string_alloc(k->str->val, k->str->size, cstr_arena_allocator(keys));
+        if(copy[i] == NULL)
+            ok = false;
+        else
+            copy[i]->str->hash = m->slots[i].hash;
+    }
+
+    if(ok)
+    {
+        for(size_t i = 0; i < n; i++)
+            if(m->ctrl[i] >= 0)
+                m->slots[i].key = copy[i];
+
+        cstr_arena_delete(m->keys);
+        m->keys = keys;
+        m->dead = 0;
+    }
+    else
+        cstr_arena_delete(keys);
+
+    free(copy);
+}
+
+bool cstr_map_put(cstr_map m, cstr_view key, void * val)
+{
+    if(m == NULL || (key.ptr == NULL && key.len))
+        return false;
+    return cstr_map_insert(m, key, cstr_view_hash(key), val);
+}
+
+bool cstr_map_put_string(cstr_map m, cstring * key, void * val)
+{
+    if(m == NULL || key == NULL)
+        return false;
+    return cstr_map_insert(m, cstr_view_of(key), cstr_hash(key), val);
+}
+
+bool cstr_map_get(cstr_map m, cstr_view key, void ** val)
+{
+    if(m == NULL || (key.ptr == NULL && key.len))
+        return false;
+
+    struct _cstr_map_slot_ * s = cstr_map_seek(m, key, cstr_view_hash(key));
+    if(s != NULL && val != NULL)
+        *val = s->val;
+    return s != NULL;
+}
+
+bool cstr_map_get_string(cstr_map m, cstring * key, void ** val)
+{
+    if(m == NULL || key == NULL)
+        return false;
+
+    // an unchanged key reuses its cached hash
+    struct _cstr_map_slot_ * s = cstr_map_seek(m, cstr_view_of(key), cstr_hash(key));
+    if(s != NULL && val != NULL)
+        *val = s->val;
+    return s != NULL;
+}
+
+bool cstr_map_remove(cstr_map m, cstr_view key)
+{
+    if(m == NULL || (key.ptr == NULL && key.len))
+        return false;
+
+    struct _cstr_map_slot_ * s = cstr_map_seek(m, key, cstr_view_hash(key));
+    if(s == NULL)
+        return false;
+
+    size_t i = (size_t)(s - m->slots);
+    const int8_t * g = m->ctrl + i / CSTR_MAP_GROUP * CSTR_MAP_GROUP;
+
+    // a group that already has an empty slot ends every probe reaching it,
+    // so the slot can become empty again instead of a tombstone
+    if(cstr_map_match(g, CSTR_MAP_EMPTY))
+    {
+        m->ctrl[i] = CSTR_MAP_EMPTY;
+        m->used--;
+    }
+    else
+        m->ctrl[i] = CSTR_MAP_DELETED;
+
+    size_t bytes = cstr_map_key_bytes(s->key->str->size);
+    delete_string(s->key);
+    m->size--;
+    m->live -= bytes;
+    m->dead += bytes;
+
+    if(m->dead > 65536 && m->dead > m->live)
+        cstr_map_compact(m);
+    return true;
+}
+
+bool cstr_map_next(cstr_map m, size_t * pos, cstring ** key, void ** val)
+{
+    if(m == NULL || pos == NULL)
+        return false;
+
+    size_t n = (m->mask + 1) * CSTR_MAP_GROUP;
+    for(; *pos < n; ++*pos)
+    {
+        if(m->ctrl[*pos] < 0)
+            continue;
+
+        if(key != NULL)
+            *key = m->slots[*pos].key;
+        if(val != NULL)
+            *val = m->slots[*pos].val;
+        ++*pos;
+        return true;
+    }
+
+    return false;
+}
+
+
+/// CSTR_WORKERS Functions ///
+
+struct _cstr_workers_
+{
+    size_t threads;             // workers besides the calling thread
+    size_t chunk;
+#if CSTR_POSIX
+    pthread_t *     tid;
+    pthread_mutex_t call;       // held for the whole of each job, one runs at a time
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_cond_t  done;
+    uint64_t        generation; // bumped to start each job
+    size_t          pending;    // workers still on the current job
+    bool            stop;
+#endif
+
+    // the current job, fn is called once for every index below count
+    void        (*fn)(void * ctx, size_t index);
+    void *        ctx;
+    size_t        count;
+    atomic_size_t next;
+};
+
+static void cstr_workers_drain(cstr_workers w)
+{
+    size_t i;
+    while((i = atomic_fetch_add_explicit(&w->next, 1, memory_order_relaxed)) < w->count)
+        w->fn(w->ctx, i);
+}
+
+#if CSTR_POSIX
+static void * cstr_workers_main(void * arg)
+{
+    cstr_workers w = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&w->lock);
+    for(;;)
+    {
+        while(!w->stop && w->generation == seen)
+            pthread_cond_wait(&w->wake, &w->lock);
+        if(w->stop)
+            break;
+
+        seen = w->generation;
+        pthread_mutex_unlock(&w->lock);
+
+        cstr_workers_drain(w);
+
+        pthread_mutex_lock(&w->lock);
+        if(--w->pending == 0)
+            pthread_cond_signal(&w->done);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+#endif
+
+cstr_workers cstr_workers_new(size_t threads, size_t chunk)
+{
+    cstr_workers w = malloc(sizeof(struct _cstr_workers_));
+    if(w == NULL)
+        return NULL;
+
+    w->threads = 0;
+    w->chunk = chunk ? chunk : CSTR_PAR_CHUNK;
+    w->fn = NULL;
+    w->ctx = NULL;
+    w->count = 0;
+    atomic_init(&w->next, 0);
+
+#if CSTR_POSIX
+    if(threads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (size_t)n : 1;
+    }
+
+    w->tid = calloc(threads, sizeof(pthread_t));
+    if(w->tid == NULL)
+    {
+        free(w);
+        return NULL;
+    }
+
+    pthread_mutex_init(&w->call, NULL);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    pthread_cond_init(&w->done, NULL);
+    w->generation = 0;
+    w->pending = 0;
+    w->stop = false;
+
+    // a worker that cannot be started only costs parallelism
+    while(w->threads < threads - 1 && pthread_create(&w->tid[w->threads], NULL, &cstr_workers_main, w) == 0)
+        w->threads++;
+#else
+    (void)threads;
+#endif
+
+    return w;
+}
+
+void cstr_workers_delete(cstr_workers w)
+{
+    if(w == NULL)
+        return;
+
+#if CSTR_POSIX
+    pthread_mutex_lock(&w->lock);
+    w->stop = true;
+    pthread_cond_broadcast(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+
+    for(size_t i = 0; i < w->threads; i++)
+        pthread_join(w->tid[i], NULL);
+
+    pthread_cond_destroy(&w->done);
+    pthread_cond_destroy(&w->wake);
+    pthread_mutex_destroy(&w->lock);
+    pthread_mutex_destroy(&w->call);
+    free(w->tid);
+#endif
+    free(w);
+}
+
+// Calls fn for every index below count spread over the pool, the calling
+// thread included, and returns once every call has
+static void cstr_workers_run(cstr_workers w, void (*fn)(void *, size_t), void * ctx, size_t count)
+{
+    if(w == NULL)
+    {
+        for(size_t i = 0; i < count; i++)
+            fn(ctx, i);
+        return;
+    }
+
+#if CSTR_POSIX
+    pthread_mutex_lock(&w->call);
+#endif
+
+    w->fn = fn;
+    w->ctx = ctx;
+    w->count = count;
+    atomic_store_explicit(&w->next, 0, memory_order_relaxed);
+
+#if CSTR_POSIX
+    if(w->threads && count > 1)
+    {
+        pthread_mutex_lock(&w->lock);
+        w->generation++;
+        w->pending = w->threads;
+        pthread_cond_broadcast(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+
+        cstr_workers_drain(w);
+
+        pthread_mutex_lock(&w->lock);
+        while(w->pending)
+            pthread_cond_wait(&w->done, &w->lock);
+        pthread_mutex_unlock(&w->lock);
+    }
+    else
+#endif
+        cstr_workers_drain(w);
+
+#if CSTR_POSIX
+    pthread_mutex_unlock(&w->call);
+#endif
+}
+
+// one parallel search, chunk i covers the occurrences that begin in
+// [from + i * chunk, from + (i + 1) * chunk)
+struct _cstr_par_job_
+{
+    const char *  h;
+    size_t        n;
+    size_t        from;
+    size_t        chunk;
+    cstr_pattern  pat;
+    const cstr_charset * set;
+    size_t        step;         // 1 when occurrences may overlap, otherwise the needle length
+    atomic_size_t best;         // lowest position found so far by find
+    atomic_bool   dense;        // a chunk had more than CSTR_PAR_STARTS starts
+    struct _cstr_par_part_ * part;
+    size_t *      out;
+    size_t        max;
+};
+
+// What find_all learns about one chunk. Each start is an occurrence the
+// leftmost search into the chunk could take first, count and last are the
+// occurrences that search takes from there and the last of them
+struct _cstr_par_part_
+{
+    size_t starts;
+    size_t start[CSTR_PAR_STARTS];
+    size_t count[CSTR_PAR_STARTS];
+    size_t last[CSTR_PAR_STARTS];
+    size_t entry;               // where the search into the chunk really starts
+    size_t first;               // where its first occurrence goes in out
+};
+
+static void cstr_par_bounds(const struct _cstr_par_job_ * j, size_t i, size_t * lo, size_t * hi)
+{
+    *lo = j->from + i * j->chunk;
+    *hi = j->n - *lo > j->chunk ? *lo + j->chunk : j->n;
+}
+
+// The first occurrence beginning in [x, hi), or npos. Only the characters an
+// occurrence there could cover are searched
+static size_t cstr_par_next(const struct _cstr_par_job_ * j, size_t x, size_t hi)
+{
+    size_t end = j->n - hi > j->pat->len - 1 ? hi + j->pat->len - 1 : j->n;
+    size_t r = x < hi ? cstr_pattern_find(j->pat, cstr_view_n(j->h, end), x) : npos;
+    return r >= hi ? npos : r;
+}
+
+static void cstr_par_find_chunk(void * ctx, size_t i)
+{
+    struct _cstr_par_job_ * j = ctx;
+    size_t lo, hi;
+    cstr_par_bounds(j, i, &lo, &hi);
+
+    // an earlier chunk already has an occurrence
+    size_t best = atomic_load_explicit(&j->best, memory_order_relaxed);
+    if(lo >= best)
+        return;
+
+    size_t r = j->set != NULL ? cstr_span_impl(j->h, hi, j->set, lo, true) : cstr_par_next(j, lo, hi);
+    while(r < best && !atomic_compare_exchange_weak_explicit(&j->best, &best, r,
+                                                            memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+// A chunk's leftmost occurrences depend on where the chunk before leaves off,
+// which is anywhere up to a needle length less one past its start. So the
+// chunk is searched from every occurrence that could come first, those before
+// that point and the first one after it, walking back from the last so a walk
+// that lands on a later start adds on its count and stops there
+static void cstr_par_count_chunk(void * ctx, size_t i)
+{
+    struct _cstr_par_job_ * j = ctx;
+    struct _cstr_par_part_ * c = &j->part[i];
+    size_t lo, hi, k = 0;
+    cstr_par_bounds(j, i, &lo, &hi);
+
+    // nothing runs into the first chunk, and when occurrences may overlap
+    // none pushes the next one on, so there only the search from the start counts
+    size_t we = lo;
+    if(i > 0 && j->step > 1)
+        we = hi - lo > j->pat->len - 1 ? lo + j->pat->len - 1 : hi;
+
+    for(size_t m = cstr_par_next(j, lo, hi); m != npos; m = cstr_par_next(j, m + 1, hi))
+    {
+        if(k == CSTR_PAR_STARTS)
+        {
+            atomic_store_explicit(&j->dense, true, memory_order_relaxed);
+            return;
+        }
+
+        c->start[k++] = m;
+        if(m >= we)
+            break;
+    }
+    c->starts = k;
+
+    for(size_t s = k; s-- > 0;)
+    {
+        size_t last = c->start[s], n = 1, m = s + 1;
+        for(size_t r = cstr_par_next(j, last + j->step, hi); r != npos; r = cstr_par_next(j, r + j->step, hi))
+        {
+            while(m < k && c->start[m] < r)
+                m++;
+            if(m < k && c->start[m] == r)
+            {
+                n += c->count[m];
+                last = c->last[m];
+                break;
+            }
+
+            n++;
+            last = r;
+        }
+
+        c->count[s] = n;
+        c->last[s] = last;
+    }
+}
+
+static void cstr_par_fill_chunk(void * ctx, size_t i)
+{
+    struct _cstr_par_job_ * j = ctx;
+    struct _cstr_par_part_ * c = &j->part[i];
+    size_t lo, hi, k = c->first;
+    cstr_par_bounds(j, i, &lo, &hi);
+
+    for(size_t r = cstr_par_next(j, c->entry, hi); r != npos && k < j->max; r = cstr_par_next(j, r + j->step, hi))
+        j->out[k++] = r;
+}
+
+// Settles each chunk's entry point from where the chunk before leaves off,
+// takes the count of the first start at or after it and sums the counts into
+// each chunk's place in out, returning the total
+static size_t cstr_par_fixup(struct _cstr_par_job_ * j, size_t chunks)
+{
+    size_t carry = 0, total = 0;
+
+    for(size_t i = 0; i < chunks; i++)
+    {
+        struct _cstr_par_part_ * c = &j->part[i];
+        size_t lo, hi, s = 0;
+        cstr_par_bounds(j, i, &lo, &hi);
+
+        c->entry = j->step > 1 && carry > lo ? carry : lo;
+        c->first = total;
+        while(s < c->starts && c->start[s] < c->entry)
+            s++;
+
+        if(s < c->starts)
+        {
+            total += c->count[s];
+            carry = c->last[s] + j->pat->len;
+        }
+    }
+
+    return total;
+}
+
+// Sets up a job over str from pos, returning the number of chunks or 0 if
+// there is nothing to search
+static size_t cstr_par_job(struct _cstr_par_job_ * j, cstr_workers w, cstring * str, size_t pos)
+{
+    memset(j, 0, sizeof(*j));
+    if(str == NULL || pos >= str->str->size)
+        return 0;
+
+    j->h = str->str->val;
+    j->n = str->str->size;
+    j->from = pos;
+    j->chunk = w == NULL ? j->n - pos : w->chunk;
+    atomic_init(&j->best, npos);
+
+    return (j->n - pos + j->chunk - 1) / j->chunk;
+}
+
+size_t cstr_par_find(cstr_workers w, cstring * str, cstr_pattern pat, size_t pos)
+{
+    struct _cstr_par_job_ j;
+    size_t chunks = cstr_par_job(&j, w, str, pos);
+    if(pat == NULL || chunks == 0)
+        return npos;
+
+    j.pat = pat;
+    cstr_workers_run(w, &cstr_par_find_chunk, &j, chunks);
+    return atomic_load(&j.best);
+}
+
+size_t cstr_par_find_first_in(cstr_workers w, cstring * str, const cstr_charset * set, size_t pos)
+{
+    struct _cstr_par_job_ j;
+    size_t chunks = cstr_par_job(&j, w, str, pos);
+    if(set == NULL || chunks == 0)
+        return npos;
+
+    j.set = set;
+    cstr_workers_run(w, &cstr_par_find_chunk, &j, chunks);
+    return atomic_load(&j.best);
+}
+
+size_t cstr_par_find_all(cstr_workers w, cstring * str, cstr_pattern pat, size_t * out, size_t max, bool overlap)
+{
+    struct _cstr_par_job_ j;
+    size_t chunks = cstr_par_job(&j, w, str, 0);
+    if(pat == NULL || chunks == 0)
+        return 0;
+
+    j.pat = pat;
+    j.step = overlap ? 1 : pat->len;
+    j.part = malloc(chunks * sizeof(*j.part));
+    atomic_init(&j.dense, false);
+
+    if(j.part != NULL)
+        cstr_workers_run(w, &cstr_par_count_chunk, &j, chunks);
+
+    if(j.part == NULL || atomic_load(&j.dense))
+    {
+        free(j.part);
+
+        // the single threaded member needs no memory at all
+        return cstr_find_all(str, pat, out, out == NULL ? 0 : max, overlap);
+    }
+
+    size_t total = cstr_par_fixup(&j, chunks);
+
+    // only chunks that have a place in out are searched again
+    if(out != NULL && max)
+    {
+        size_t fill = 0;
+        while(fill < chunks && j.part[fill].first < max)
+            fill++;
+
+        j.out = out;
+        j.max = max;
+        cstr_workers_run(w, &cstr_par_fill_chunk, &j, fill);
+    }
+
+    free(j.part);
+    return total;
+}
+
+size_t cstr_par_count(cstr_workers w, cstring * str, cstr_pattern pat, bool overlap)
+{
+    return cstr_par_find_all(w, str, pat, NULL, 0, overlap);
+}
+
+
+/// CSTR_BATCH Functions ///
+
+#define CSTR_BATCH_CHUNK    4096    // strings each worker takes at a time
+#define CSTR_BATCH_AHEAD    8       // strings read ahead of the current one
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CSTR_PREFETCH(p)    __builtin_prefetch(p)
+#else
+#define CSTR_PREFETCH(p)    ((void)(p))
+#endif
+
+struct _cstr_batch_
+{
+    void (*run)(struct _cstr_batch_ * b, size_t lo, size_t hi);
+    cstring * const *   strs;
+    const cstr_view *   views;
+    size_t              n;
+    cstr_view           with;
+    cstr_pattern        pat;
+    void *              out;
+    atomic_size_t       hits;
+};
+
+// Reading a string takes two dependent loads, the cstring and then the header
+// it points to. The cstring is fetched twice as far ahead so that its header
+// pointer is in cache by the time the header itself is fetched
+static inline void cstr_batch_ahead(const struct _cstr_batch_ * b, size_t i)
+{
+    if(b->strs != NULL)
+    {
+        if(i + 2 * CSTR_BATCH_AHEAD < b->n && b->strs[i + 2 * CSTR_BATCH_AHEAD] != NULL)
+            CSTR_PREFETCH(b->strs[i + 2 * CSTR_BATCH_AHEAD]);
+        if(i + CSTR_BATCH_AHEAD < b->n && b->strs[i + CSTR_BATCH_AHEAD] != NULL)
+            CSTR_PREFETCH(b->strs[i + CSTR_BATCH_AHEAD]->str);
+    }
+    else if(i + CSTR_BATCH_AHEAD < b->n)
+        CSTR_PREFETCH(b->views[i + CSTR_BATCH_AHEAD].ptr);
+}
+
+static inline cstr_view cstr_batch_view(const struct _cstr_batch_ * b, size_t i)
+{
+    if(b->views != NULL)
+        return b->views[i];
+    return b->strs[i] == NULL ? cstr_view_n("", 0) : cstr_view_of(b->strs[i]);
+}
+
+static void cstr_batch_length_range(struct _cstr_batch_ * b, size_t lo, size_t hi)
+{
+    size_t * out = b->out;
+    for(size_t i = lo; i < hi; i++)
+    {
+        cstr_batch_ahead(b, i);
+        out[i] = b->strs[i] == NULL ? 0 : b->strs[i]->str->size;
+    }
+}
+
+static void cstr_batch_hash_range(struct _cstr_batch_ * b, size_t lo, size_t hi)
+{
+    uint64_t * out = b->out;
+    for(size_t i = lo; i < hi; i++)
+    {
+        cstr_batch_ahead(b, i);
+        out[i] = b->strs != NULL ? (b->strs[i] == NULL ? cstr_wyhash("", 0) : cstr_hash(b->strs[i]))
+                                 : cstr_view_hash(b->views[i]);
+    }
+}
+
+static void cstr_batch_compare_range(struct _cstr_batch_ * b, size_t lo, size_t hi)
+{
+    bool * out = b->out;
+    size_t hits = 0;
+    for(size_t i = lo; i < hi; i++)
+    {
+        cstr_batch_ahead(b, i);
+        bool eq = cstr_view_compare(cstr_batch_view(b, i), b->with);
+        hits += eq;
+        if(out != NULL)
+            out[i] = eq;
+    }
+    atomic_fetch_add_explicit(&b->hits, hits, memory_order_relaxed);
+}
+
+static void cstr_batch_find_range(struct _cstr_batch_ * b, size_t lo, size_t hi)
+{
+    size_t * out = b->out;
+    size_t hits = 0;
+    for(size_t i = lo; i < hi; i++)
+    {
+        cstr_batch_ahead(b, i);
+        size_t pos = cstr_pattern_find(b->pat, cstr_batch_view(b, i), 0);
+        hits += pos != npos;
+        if(out != NULL)
+            out[i] = pos;
+    }
+    atomic_fetch_add_explicit(&b->hits, hits, memory_order_relaxed);
+}
+
+static void cstr_batch_fold_range(struct _cstr_batch_ * b, size_t lo, size_t hi)
+{
+    for(size_t i = lo; i < hi; i++)
+    {
+        cstr_batch_ahead(b, i);
+
+        cstring * str = b->strs[i];
+        if(str == NULL)
+            continue;
+
+        // strings that are already lower case are only read, never copied
+        size_t len = str->str->size;
+        size_t k = 0;
+        while(k < len && (unsigned char)(str->str->val[k] - 'A') >= 26)
+            k++;
+        if(k == len)
+            continue;
+
+        if(cstr_is_readonly(str) && !cstr_detach(str, str->str->val, len, len))
+            continue;
+
+        // branch free so that compilers vectorize it
+        unsigned char * v = (unsigned char *)str->str->val;
+        for(; k < len; k++)
+            v[k] |= (unsigned char)((unsigned char)(v[k] - 'A') < 26) << 5;
+        str->str->hash = 0;
+    }
+}
+
+static void cstr_batch_chunk(void * ctx, size_t i)
+{
+    struct _cstr_batch_ * b = ctx;
+    size_t lo = i * CSTR_BATCH_CHUNK;
+    b->run(b, lo, b->n - lo > CSTR_BATCH_CHUNK ? lo + CSTR_BATCH_CHUNK : b->n);
+}
+
+static size_t cstr_batch_run(cstr_workers w, struct _cstr_batch_ * b)
+{
+    atomic_init(&b->hits, 0);
+    if(b->n <= CSTR_BATCH_CHUNK)
+        b->run(b, 0, b->n);
+    else
+        cstr_workers_run(w, &cstr_batch_chunk, b, (b->n + CSTR_BATCH_CHUNK - 1) / CSTR_BATCH_CHUNK);
+    return atomic_load(&b->hits);
+}
+
+void cstr_batch_length(cstr_workers w, cstring * const * strs, size_t n, size_t * out)
+{
+    if(strs == NULL || out == NULL)
+        return;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_length_range, .strs = strs, .n = n, .out = out };
+    cstr_batch_run(w, &b);
+}
+
+void cstr_batch_hash(cstr_workers w, cstring * const * strs, size_t n, uint64_t * out)
+{
+    if(strs == NULL || out == NULL)
+        return;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_hash_range, .strs = strs, .n = n, .out = out };
+    cstr_batch_run(w, &b);
+}
+
+size_t cstr_batch_compare(cstr_workers w, cstring * const * strs, size_t n, cstr_view with, bool * out)
+{
+    if(strs == NULL)
+        return 0;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_compare_range, .strs = strs, .n = n, .with = with, .out = out };
+    return cstr_batch_run(w, &b);
+}
+
+size_t cstr_batch_find(cstr_workers w, cstring * const * strs, size_t n, cstr_pattern pat, size_t * out)
+{
+    if(strs == NULL || pat == NULL)
+        return 0;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_find_range, .strs = strs, .n = n, .pat = pat, .out = out };
+    return cstr_batch_run(w, &b);
+}
+
+void cstr_batch_fold(cstr_workers w, cstring * const * strs, size_t n)
+{
+    if(strs == NULL)
+        return;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_fold_range, .strs = strs, .n = n };
+    cstr_batch_run(w, &b);
+}
+
+void cstr_batch_view_hash(cstr_workers w, const cstr_view * views, size_t n, uint64_t * out)
+{
+    if(views == NULL || out == NULL)
+        return;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_hash_range, .views = views, .n = n, .out = out };
+    cstr_batch_run(w, &b);
+}
+
+size_t cstr_batch_view_compare(cstr_workers w, const cstr_view * views, size_t n, cstr_view with, bool * out)
+{
+    if(views == NULL)
+        return 0;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_compare_range, .views = views, .n = n, .with = with, .out = out };
+    return cstr_batch_run(w, &b);
+}
+
+size_t cstr_batch_view_find(cstr_workers w, const cstr_view * views, size_t n, cstr_pattern pat, size_t * out)
+{
+    if(views == NULL || pat == NULL)
+        return 0;
+
+    struct _cstr_batch_ b = { .run = &cstr_batch_find_range, .views = views, .n = n, .pat = pat, .out = out };
+    return cstr_batch_run(w, &b);
+}
+
+
+/// CPU Dispatch ///
+
+#if CSTR_SIMD
+
+// picks the widest version of each vectorized search the CPU supports
+__attribute__((constructor))
+static void cstr_simd_select(void)
+{
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512bw"))
+        cstr_scan_impl = &cstr_scan_avx512;
+    else if(__builtin_cpu_supports("avx2"))
+        cstr_scan_impl = &cstr_scan_avx2;
+
+    if(__builtin_cpu_supports("avx2"))
+    {
+        cstr_span_impl = &cstr_span_avx2;
+        cstr_rspan_impl = &cstr_rspan_avx2;
+    }
+    else if(__builtin_cpu_supports("ssse3"))
+    {
+        cstr_span_impl = &cstr_span_ssse3;
+        cstr_rspan_impl = &cstr_rspan_ssse3;
+    }
+}
+
+#endif
+
+
+/// CSTR_ARENA Functions ///
+
+#define CSTR_ARENA_ALIGN    _Alignof(max_align_t)
+
+// one region of an arena, allocations are carved from data in order
+struct _cstr_arena_block_
+{
+    struct _cstr_arena_block_ * prev;
+    size_t size;            // bytes in data
+    size_t used;            // bytes of data handed out
+    char   data[];
+};
+
+struct _cstr_arena_
+{
+    cstr_allocator alloc;   // hooks handed to cstrings, ctx is the arena
+    struct _cstr_arena_block_ * head;
+    size_t block_size;
+    void * last;            // most recent allocation, the only one that can grow or be undone in place
+};
+
+static size_t cstr_arena_pad(struct _cstr_arena_block_ * b)
+{
+    uintptr_t p = (uintptr_t)(b->data + b->used);
+    return (CSTR_ARENA_ALIGN - p % CSTR_ARENA_ALIGN) % CSTR_ARENA_ALIGN;
+}
+
+static void * cstr_arena_alloc(void * ctx, size_t size)
+{
+    cstr_arena arena = ctx;
+    struct _cstr_arena_block_ * b = arena->head;
+
+    if(b == NULL || b->size - b->used < cstr_arena_pad(b) + size)
+    {
+        // oversized requests get a block of their own
+        size_t bsize = size + CSTR_ARENA_ALIGN > arena->block_size ? size + CSTR_ARENA_ALIGN : arena->block_size;
+        b = malloc(sizeof(struct _cstr_arena_block_) + bsize);
+        if(b == NULL)
+            return NULL;
+
+        b->prev = arena->head;
+        b->size = bsize;
+        b->used = 0;
+        arena->head = b;
+    }
+
+    b->used += cstr_arena_pad(b);
+    arena->last = b->data + b->used;
+    b->used += size;
+    return arena->last;
+}
+
+static void * cstr_arena_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    cstr_arena arena = ctx;
+    struct _cstr_arena_block_ * b = arena->head;
+
+    if(ptr == NULL)
+        return cstr_arena_alloc(ctx, new_size);
+
+    // the newest allocation can be resized where it is if the block has room
+    if(ptr == arena->last && (char*)ptr + new_size <= b->data + b->size)
+    {
+        b->used = (char*)ptr - b->data + new_size;
+        return ptr;
+    }
+
+    void * p = cstr_arena_alloc(ctx, new_size);
+    if(p != NULL)
+        memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    return p;
+}
+
+static void cstr_arena_free(void * ctx, void * ptr, size_t size)
+{
+    cstr_arena arena = ctx;
+
+    // only the newest allocation is given back, the rest waits for a reset
+    if(ptr != NULL && ptr == arena->last)
+    {
+        arena->head->used = (char*)ptr - arena->head->data;
+        arena->last = NULL;
+    }
+    (void)size;
+}
+
+cstr_arena cstr_arena_new(size_t block_size)
+{
+    cstr_arena arena = malloc(sizeof(struct _cstr_arena_));
+    if(arena == NULL)
+        return NULL;
+
+    arena->alloc.alloc = &cstr_arena_alloc;
+    arena->alloc.realloc = &cstr_arena_realloc;
+    arena->alloc.free = &cstr_arena_free;
+    arena->alloc.ctx = arena;
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : CSTR_ARENA_BLOCK;
+    arena->last = NULL;
+
+    return arena;
+}
+
+const cstr_allocator * cstr_arena_allocator(cstr_arena arena)
+{
+    return arena == NULL ? NULL : &arena->alloc;
+}
+
+void cstr_arena_reset(cstr_arena arena)
+{
+    if(arena == NULL || arena->head == NULL)
+        return;
+
+    // keeps the oldest block for reuse and frees the ones added after it
+    while(arena->head->prev != NULL)
+    {
+        struct _cstr_arena_block_ * prev = arena->head->prev;
+        free(arena->head);
+        arena->head = prev;
+    }
+
+    arena->head->used = 0;
+    arena->last = NULL;
+}
+
+void cstr_arena_delete(cstr_arena arena)
+{
+    if(arena == NULL)
+        return;
+
+    while(arena->head != NULL)
+    {
+        struct _cstr_arena_block_ * prev = arena->head->prev;
+        free(arena->head);
+        arena->head = prev;
+    }
+
+    free(arena);
+}
+
+
+/// CSTR_ROPE Functions ///
+
+// a piece of text, the rope is an implicit treap of pieces ordered by
+// position with each node heavier than its children
+struct _cstr_rope_node_
+{
+    struct _cstr_rope_node_ * left;
+    struct _cstr_rope_node_ * right;
+    uint32_t     weight;    // random heap priority that keeps the tree balanced
+    size_t       total;     // characters in this subtree
+    const char * ptr;       // characters of this piece
+    size_t       len;
+};
+
+// text is copied into blocks that are never moved, so pieces can point into them
+struct _cstr_rope_block_
+{
+    struct _cstr_rope_block_ * next;
+    size_t size;
+    size_t used;
+    char   data[];
+};
+
+struct _cstr_rope_
+{
+    struct _cstr_rope_node_  * root;
+    struct _cstr_rope_block_ * blocks;  // newest first, inserts append to the head
+    const char * flat;                  // contiguous copy made by data, NULL after an edit
+    uint32_t     seed;
+};
+
+typedef struct _cstr_rope_node_ * rope_node;
+
+static size_t rope_total(rope_node t)
+{
+    return t == NULL ? 0 : t->total;
+}
+
+static void rope_update(rope_node t)
+{
+    t->total = rope_total(t->left) + t->len + rope_total(t->right);
+}
+
+static rope_node rope_node_new(cstr_rope rope, const char * ptr, size_t len)
+{
+    rope_node t = malloc(sizeof(struct _cstr_rope_node_));
+    if(t == NULL)
+        return NULL;
+
+    // xorshift32
+    rope->seed ^= rope->seed << 13;
+    rope->seed ^= rope->seed >> 17;
+    rope->seed ^= rope->seed << 5;
+
+    t->left = t->right = NULL;
+    t->weight = rope->seed;
+    t->ptr = ptr;
+    t->len = len;
+    t->total = len;
+    return t;
+}
+
+static void rope_free_nodes(rope_node t)
+{
+    if(t == NULL)
+        return;
+    rope_free_nodes(t->left);
+    rope_free_nodes(t->right);
+    free(t);
+}
+
+static rope_node rope_merge(rope_node a, rope_node b)
+{
+    if(a == NULL)
+        return b;
+    if(b == NULL)
+        return a;
+
+    if(a->weight >= b->weight)
+    {
+        a->right = rope_merge(a->right, b);
+        rope_update(a);
+        return a;
+    }
+
+    b->left = rope_merge(a, b->left);
+    rope_update(b);
+    return b;
+}
+
+// Splits t into the first k characters and the rest, a piece that straddles
+// the split is cut in two. Returns false if that cut cannot be allocated,
+// in which case t is left as it was
+static bool rope_split(cstr_rope rope, rope_node t, size_t k, rope_node * l, rope_node * r)
+{
+    if(t == NULL)
+    {
+        *l = *r = NULL;
+        return true;
+    }
+
+    size_t left = rope_total(t->left);
+
+    if(k <= left)
+    {
+        if(!rope_split(rope, t->left, k, l, &t->left))
+            return false;
+        rope_update(t);
+        *r = t;
+    }
+    else if(k >= left + t->len)
+    {
+        if(!rope_split(rope, t->right, k - left - t->len, &t->right, r))
+            return false;
+        rope_update(t);
+        *l = t;
+    }
+    else
+    {
+        size_t off = k - left;
+        rope_node tail = rope_node_new(rope, t->ptr + off, t->len - off);
+        if(tail == NULL)
+            return false;
+
+        t->len = off;
+        *r = rope_merge(tail, t->right);
+        t->right = NULL;
+        rope_update(t);
+        *l = t;
+    }
+
+    return true;
+}
+
+// Grows the last piece of t by len characters if they directly follow it,
+// so text typed one character at a time stays in a single piece
+static bool rope_extend(rope_node t, const char * ptr, size_t len)
+{
+    if(t == NULL)
+        return false;
+
+    if(t->right != NULL ? !rope_extend(t->right, ptr, len) : t->ptr + t->len != ptr)
+        return false;
+
+    if(t->right == NULL)
+        t->len += len;
+    t->total += len;
+    return true;
+}
+
+// Copies len characters into the rope's blocks and returns where they went
+static const char * rope_store(cstr_rope rope, const char * str, size_t len)
+{
+    struct _cstr_rope_block_ * b = rope->blocks;
+
+    if(b == NULL || b->size - b->used < len)
+    {
+        size_t size = len > CSTR_ROPE_BLOCK ? len : CSTR_ROPE_BLOCK;
+        b = malloc(sizeof(struct _cstr_rope_block_) + size);
+        if(b == NULL)
+            return NULL;
+
+        b->next = rope->blocks;
+        b->size = size;
+        b->used = 0;
+        rope->blocks = b;
+    }
+
+    char * p = b->data + b->used;
+    memcpy(p, str, len);
+    b->used += len;
+    return p;
+}
+
+static void rope_free_blocks(struct _cstr_rope_block_ * b)
+{
+    while(b != NULL)
+    {
+        struct _cstr_rope_block_ * next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+cstr_rope cstr_rope_new(const char * str)
+{
+    return cstr_rope_n(str, str == NULL ? 0 : strlen(str));
+}
+
+cstr_rope cstr_rope_n(const char * str, size_t len)
+{
+    cstr_rope rope = malloc(sizeof(struct _cstr_rope_));
+    if(rope == NULL)
+        return NULL;
+
+    rope->root = NULL;
+    rope->blocks = NULL;
+    rope->flat = NULL;
+    rope->seed = 2463534242u;
+
+    if(str != NULL && len)
+        cstr_rope_insert_n(rope, 0, str, len);
+
+    return rope;
+}
+
+void cstr_rope_delete(cstr_rope rope)
+{
+    if(rope == NULL)
+        return;
+
+    rope_free_nodes(rope->root);
+    rope_free_blocks(rope->blocks);
+    free(rope);
+}
+
+size_t cstr_rope_length(cstr_rope rope)
+{
+    return rope == NULL ? 0 : rope_total(rope->root);
+}
+
+void cstr_rope_insert(cstr_rope rope, size_t pos, const char * str)
+{
+    if(str != NULL)
+        cstr_rope_insert_n(rope, pos, str, strlen(str));
+}
+
+void cstr_rope_insert_n(cstr_rope rope, size_t pos, const char * str, size_t len)
+{
+    if(rope == NULL || str == NULL || len == 0 || pos > rope_total(rope->root))
+        return;
+
+    const char * p = rope_store(rope, str, len);
+    if(p == NULL)
+        return;
+
+    rope_node l, r, t;
+    if(!rope_split(rope, rope->root, pos, &l, &r))
+        return;
+
+    if(!rope_extend(l, p, len))
+    {
+        t = rope_node_new(rope, p, len);
+        if(t == NULL)
+        {
+            rope->root = rope_merge(l, r);
+            return;
+        }
+        l = rope_merge(l, t);
+    }
+
+    rope->root = rope_merge(l, r);
+    rope->flat = NULL;
+}
+
+void cstr_rope_erase(cstr_rope rope, size_t pos, size_t len)
+{
+    if(rope == NULL || pos >= rope_total(rope->root) || len == 0)
+        return;
+
+    rope_node a, b, m, c;
+    if(!rope_split(rope, rope->root, pos, &a, &b))
+        return;
+    if(!rope_split(rope, b, len, &m, &c))
+    {
+        rope->root = rope_merge(a, b);
+        return;
+    }
+
+    rope_free_nodes(m);
+    rope->root = rope_merge(a, c);
+    rope->flat = NULL;
+}
+
+char cstr_rope_at(cstr_rope rope, size_t pos)
+{
+    rope_node t = rope == NULL ? NULL : rope->root;
+
+    while(t != NULL)
+    {
+        size_t left = rope_total(t->left);
+        if(pos < left)
+            t = t->left;
+        else if(pos < left + t->len)
+            return t->ptr[pos - left];
+        else
+        {
+            pos -= left + t->len;
+            t = t->right;
+        }
+    }
+
+    return '\0';
+}
+
+// Visits the pieces of t in order from position 'from' on, the first piece
+// is trimmed to start there. Returns false once fn asks to stop
+static bool rope_walk(rope_node t, size_t from, bool (*fn)(void *, const char *, size_t), void * ctx)
+{
+    if(t == NULL)
+        return true;
+
+    size_t left = rope_total(t->left);
+
+    if(from < left && !rope_walk(t->left, from, fn, ctx))
+        return false;
+
+    if(from < left + t->len)
+    {
+        size_t off = from > left ? from - left : 0;
+        if(!fn(ctx, t->ptr + off, t->len - off))
+            return false;
+    }
+
+    return rope_walk(t->right, from > left + t->len ? from - left - t->len : 0, fn, ctx);
+}
+
+void cstr_rope_each(cstr_rope rope, bool (*fn)(void * ctx, const char * piece, size_t len), void * ctx)
+{
+    if(rope != NULL && fn != NULL)
+        rope_walk(rope->root, 0, fn, ctx);
+}
+
+// state of a search across pieces, win holds the last len - 1 characters
+// seen so matches that straddle two pieces can be found
+struct _cstr_rope_find_
+{
+    const char * needle;
+    size_t len;
+    size_t off;         // position of the current piece in the rope
+    char * win;         // room for 2 * (len - 1) characters
+    size_t win_len;
+    size_t ret;
+};
+
+static bool rope_find_piece(void * ctx, const char * piece, size_t plen)
+{
+    struct _cstr_rope_find_ * f = ctx;
+    size_t keep = f->len - 1;
+
+    // a match that starts in the window and ends in this piece
+    if(f->win_len)
+    {
+        size_t k = plen < keep ? plen : keep;
+        memcpy(f->win + f->win_len, piece, k);
+        size_t p = cstr_scan(f->win, f->win_len + k, f->needle, f->len, 0);
+        if(p != npos && p < f->win_len)
+        {
+            f->ret = f->off - f->win_len + p;
+            return false;
+        }
+    }
+
+    size_t p = cstr_scan(piece, plen, f->needle, f->len, 0);
+    if(p != npos)
+    {
+        f->ret = f->off + p;
+        return false;
+    }
+
+    // keeps the last len - 1 characters of everything seen so far
+    if(plen >= keep)
+    {
+        memcpy(f->win, piece + plen - keep, keep);
+        f->win_len = keep;
+    }
+    else if(keep)
+    {
+        size_t total = f->win_len + plen;
+        size_t drop = total > keep ? total - keep : 0;
+        memmove(f->win, f->win + drop, f->win_len - drop);
+        memcpy(f->win + f->win_len - drop, piece, plen);
+        f->win_len = total - drop;
+    }
+
+    f->off += plen;
+    return true;
+}
+
+size_t cstr_rope_find(cstr_rope rope, const char * str, size_t * nxtpos)
+{
+    if(str == NULL)
+        return npos;
+    return cstr_rope_find_n(rope, str, strlen(str), nxtpos);
+}
+
+size_t cstr_rope_find_n(cstr_rope rope, const char * str, size_t len, size_t * nxtpos)
+{
+    if(rope == NULL || str == NULL || !len || !rope_total(rope->root))
+        return npos;
+
+    size_t from = nxtpos == NULL ? 0 : *nxtpos;
+    char small[256];
+    char * win = 2 * (len - 1) <= sizeof(small) ? small : malloc(2 * (len - 1));
+    if(win == NULL)
+        return npos;
+
+    struct _cstr_rope_find_ f = { str, len, from, win, 0, npos };
+    if(from < rope_total(rope->root))
+        rope_walk(rope->root, from, &rope_find_piece, &f);
+
+    if(win != small)
+        free(win);
+
+    // sets the next search position if another search is run
+    if(nxtpos != NULL)
+        *nxtpos = f.ret + len;
+
+    return f.ret;
+}
+
+// copies the pieces visited by rope_walk into a buffer, up to 'left' characters
+struct _cstr_rope_copy_
+{
+    char * out;
+    size_t left;
+};
+
+static bool rope_copy_piece(void * ctx, const char * piece, size_t plen)
+{
+    struct _cstr_rope_copy_ * c = ctx;
+    size_t n = plen < c->left ? plen : c->left;
+
+    memcpy(c->out, piece, n);
+    c->out += n;
+    c->left -= n;
+    return c->left > 0;
+}
+
+char * cstr_rope_substr(cstr_rope rope, size_t pos, size_t len)
+{
+    size_t total = cstr_rope_length(rope);
+    if(rope == NULL || pos > total)
+        return NULL;
+
+    if(len > total - pos)
+        len = total - pos;
+
+    char * sz = malloc(len + CSTR_PAD);
+    if(sz == NULL)
+        return NULL;
+
+    struct _cstr_rope_copy_ c = { sz, len };
+    if(len)
+        rope_walk(rope->root, pos, &rope_copy_piece, &c);
+    sz[len] = '\0';
+
+    return sz;
+}
+
+const char * cstr_rope_data(cstr_rope rope)
+{
+    if(rope == NULL || rope->root == NULL)
+        return "";
+    if(rope->flat != NULL)
+        return rope->flat;
+
+    // joins the text into one block which becomes the only piece,
+    // every older block is then unreferenced and can be released
+    size_t total = rope_total(rope->root);
+    struct _cstr_rope_block_ * b = malloc(sizeof(struct _cstr_rope_block_) + total + CSTR_PAD);
+    rope_node t = rope_node_new(rope, b == NULL ? NULL : b->data, total);
+    if(b == NULL || t == NULL)
+    {
+        free(b);
+        free(t);
+        return NULL;
+    }
+
+    struct _cstr_rope_copy_ c = { b->data, total };
+    rope_walk(rope->root, 0, &rope_copy_piece, &c);
+    b->data[total] = '\0';
+
+    // the terminator is reserved so later inserts never write over it
+    b->next = NULL;
+    b->size = total + CSTR_PAD;
+    b->used = total + CSTR_PAD;
+
+    rope_free_nodes(rope->root);
+    rope_free_blocks(rope->blocks);
+    rope->root = t;
+    rope->blocks = b;
+    rope->flat = b->data;
+
+    return rope->flat;
+}
+
+
+/// CSTRING_BUILDER Functions ///
+
+struct _cstring_builder_
+{
+    cstring * str;      // the cstring being built, handed out by finish
+    bool      failed;   // set once any step could not allocate
+};
+
+cstring_builder cstr_builder_new(size_t cap)
+{
+    return cstr_builder_alloc(cap, NULL);
+}
+
+cstring_builder cstr_builder_alloc(size_t cap, const cstr_allocator * alloc)
+{
+    cstring_builder b = malloc(sizeof(struct _cstring_builder_));
+    if(b == NULL)
+        return NULL;
+
+    b->str = string_alloc("", 0, alloc);
+    b->failed = false;
+
+    if(b->str == NULL)
+    {
+        free(b);
+        return NULL;
+    }
+
+    cstr_builder_reserve(b, cap);
+    return b;
+}
+
+void cstr_builder_reserve(cstring_builder b, size_t cap)
+{
+    if(b == NULL || cap <= b->str->str->capacity)
+        return;
+    if(!cstr_realloc(b->str, cap))
+        b->failed = true;
+}
+
+void cstr_builder_append(cstring_builder b, const char * s)
+{
+    if(s != NULL)
+        cstr_builder_append_n(b, s, strlen(s));
+}
+
+void cstr_builder_append_n(cstring_builder b, const char * s, size_t len)
+{
+    if(b == NULL || s == NULL || len == 0)
+        return;
+
+    cstr t = b->str->str;
+    if(t->capacity - t->size < len)
+    {
+        if(!cstr_grow(b->str, t->size + len))
+        {
+            b->failed = true;
+            return;
+        }
+        t = b->str->str;
+    }
+
+    memcpy(t->val + t->size, s, len);
+    t->size += len;
+    t->hash = 0;
+    t->val[t->size] = '\0';
+}
+
+void cstr_builder_append_view(cstring_builder b, cstr_view v)
+{
+    cstr_builder_append_n(b, v.ptr, v.len);
+}
+
+void cstr_builder_append_all(cstring_builder b, const cstr_view * parts, size_t count)
+{
+    if(b == NULL || parts == NULL)
+        return;
+
+    size_t total = 0;
+    for(size_t i = 0; i < count; i++)
+        total += parts[i].len;
+
+    if(!cstr_grow(b->str, b->str->str->size + total))
+    {
+        b->failed = true;
+        return;
+    }
+
+    for(size_t i = 0; i < count; i++)
+        cstr_builder_append_n(b, parts[i].ptr, parts[i].len);
+}
+
+void cstr_builder_concat(cstring_builder b, ...)
+{
+    if(b == NULL)
+        return;
+
+    va_list args, again;
+    va_start(args, b);
+    va_copy(again, args);
+
+    // measures every piece first so the buffer grows once
+    size_t total = 0;
+    for(const char * s = va_arg(args, const char *); s != NULL; s = va_arg(args, const char *))
+        total += strlen(s);
+    va_end(args);
+
+    if(!cstr_grow(b->str, b->str->str->size + total))
+        b->failed = true;
+    else
+        for(const char * s = va_arg(again, const char *); s != NULL; s = va_arg(again, const char *))
+            cstr_builder_append(b, s);
+    va_end(again);
+}
+
+void cstr_builder_appendf(cstring_builder b, const char * fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    cstr_builder_vappendf(b, fmt, args);
+    va_end(args);
+}
+
+void cstr_builder_vappendf(cstring_builder b, const char * fmt, va_list args)
+{
+    if(b == NULL || fmt == NULL)
+        return;
+
+    va_list again;
+    va_copy(again, args);
+
+    // formats into the spare capacity, the terminator slot counts as room
+    cstr t = b->str->str;
+    size_t room = t->capacity - t->size + CSTR_PAD;
+    int n = vsnprintf(t->val + t->size, room, fmt, args);
+
+    if(n < 0)
+        b->failed = true;
+    else if((size_t)n >= room)
+    {
+        // too long, grow once to the exact size needed and format again
+        if(!cstr_grow(b->str, t->size + n))
+            b->failed = true;
+        else
+        {
+            t = b->str->str;
+            vsnprintf(t->val + t->size, n + CSTR_PAD, fmt, again);
+        }
+    }
+
+    if(n >= 0 && !b->failed)
+    {
+        t->size += n;
+        t->hash = 0;
+    }
+    t->val[t->size] = '\0';
+    va_end(again);
+}
+
+size_t cstr_builder_length(cstring_builder b)
+{
+    return b == NULL ? 0 : b->str->str->size;
+}
+
+const char * cstr_builder_data(cstring_builder b)
+{
+    return b == NULL ? NULL : b->str->str->val;
+}
+
+bool cstr_builder_ok(cstring_builder b)
+{
+    return b != NULL && !b->failed;
+}
+
+cstring * cstr_builder_finish(cstring_builder b)
+{
+    if(b == NULL)
+        return NULL;
+
+    cstring * cs = b->str;
+    if(b->failed)
+    {
+        delete_string(cs);
+        cs = NULL;
+    }
+
+    free(b);
+    return cs;
+}
+
+void cstr_builder_delete(cstring_builder b)
+{
+    if(b == NULL)
+        return;
+    delete_string(b->str);
+    free(b);
 }
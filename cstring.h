@@ -1,15 +1,23 @@
 /** C++ std::string clone : CSTRING
  *
  *  This attempts to mimic the std::string class found in C++ implementation of string.h
- *  cstring stores pointers to functions that act almost identically to those of its
+ *  cstring points to a shared table of functions that act almost identically to those of its
  *  C++ counterpart and can be accessed like a C++ class using (*) or -> dereferences
- *  and accessing the function members of the cstring struct.
+ *  and accessing the function members of the cstring's ops table.
  *
  *  All functions require a reference to the cstring and should be called by passing
  *  the pointer to itself as the first parameter.
  *
- *  E.G. cstring->data(cstring) // returns a const char * to the content of cstring
- *       cstring->find(cstring,"testing",0) // returns the position of the first occurence of "testing"
+ *  E.G. cstring->ops->data(cstring) // returns a const char * to the content of cstring
+ *       cstring->ops->find(cstring,"testing",0) // returns the position of the first occurence of "testing"
+ *
+ *  Every member can also be called directly as cstr_<member>, which skips the indirect call
+ *
+ *  E.G. cstr_data(cstring) // same as cstring->ops->data(cstring)
+ *
+ *  Code written against the older layout, where the members sat in the cstring itself as
+ *  cstring->find(cstring,...), builds unchanged with CSTR_LEGACY_MEMBERS defined before
+ *  including this file, see LEGACY MEMBERS at the end of it
  *
  *  NOTE:
  *  CSTRING is not meant to be a memory efficient form of a string implementation
@@ -23,13 +31,13 @@
 /* EXAMPLES OF USE
  *
  * cstring * str = string("this is a cstring");
- * printf("%s str->data()\n", str->data(str));
- * printf("'a' can be found at %d in str->find()\n", str->find(str,"a",0", NULL));
- * printf("%s is %d characters long\n", str->data(str), str->length(str));
+ * printf("%s str->data()\n", str->ops->data(str));
+ * printf("'a' can be found at %d in str->find()\n", str->ops->find(str,"a",0", NULL));
+ * printf("%s is %d characters long\n", str->ops->data(str), cstr_length(str));
  * printf("str can't be longer than %d characters on your processor\n",
- *        str->max_size(str));
- * str->clear(str);
- * printf("str is now clear? %d\n", str->empty(str));
+ *        str->ops->max_size(str));
+ * cstr_clear(str);
+ * printf("str is now clear? %d\n", str->ops->empty(str));
  * delete_string(str);
  *
  */
@@ -40,10 +48,13 @@
 #define CSTRING_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <stdarg.h>
 
 #ifndef ITERATOR
 #define ITERATOR
@@ -56,12 +67,83 @@
 #endif
 
 typedef struct _cstring_          cstring;
+typedef struct _cstring_ops_      cstring_ops;
 typedef struct _cstr_           * cstr;
 typedef struct _base_iterator_  * base_iterator;
 typedef struct _cstr_iterator_  * cstr_iterator;
+typedef struct _cstr_it_          cstr_it;
+typedef struct _cstr_view_        cstr_view;
+typedef struct _cstr_charset_     cstr_charset;
+typedef struct _cstr_pattern_   * cstr_pattern;
+typedef struct _cstr_matches_     cstr_matches;
+typedef struct _cstr_automaton_ * cstr_automaton;
+typedef struct _cstr_hit_         cstr_hit;
+typedef struct _cstr_token_       cstr_token;
+typedef struct _cstr_split_       cstr_split;
+typedef struct _cstr_stream_    * cstr_stream;
+typedef struct _cstr_pool_      * cstr_pool;
+typedef struct _cstr_map_       * cstr_map;
+typedef struct _cstr_workers_   * cstr_workers;
+typedef struct _cstr_allocator_   cstr_allocator;
+typedef struct _cstr_arena_     * cstr_arena;
+typedef struct _cstr_rope_      * cstr_rope;
+typedef struct _cstring_builder_ * cstring_builder;
 
 static const long int npos = LONG_MAX;
 
+// Strings up to this many characters are stored inside the cstring itself
+// and only move to the heap once they outgrow it
+#define CSTR_SSO_CAPACITY   23
+
+// Words of a cstring's sso storage set aside for the string header
+#define CSTR_SSO_HEADER     4
+
+// Default number of bytes a stream search reads at a time
+#define CSTR_STREAM_CHUNK   65536
+
+// Default number of characters each worker of a parallel search takes at a time
+#define CSTR_PAR_CHUNK      (1 << 20)
+
+// Most occurrences a parallel count follows from the start of each chunk
+// before it gives up and counts on one thread instead
+#define CSTR_PAR_STARTS     8
+
+// Default size of the blocks an arena carves allocations from
+#define CSTR_ARENA_BLOCK    65536
+
+// Size of the blocks a rope copies inserted text into
+#define CSTR_ROPE_BLOCK     4096
+
+
+// Memory hooks a cstring can be created with, every allocation the cstring
+// makes for itself goes through them. ctx is passed back on every call and
+// the sizes of the blocks being resized or freed are always supplied
+struct _cstr_allocator_
+{
+    void *  (*alloc)    (void * ctx, size_t size);
+    void *  (*realloc)  (void * ctx, void * ptr, size_t old_size, size_t new_size);
+    void    (*free)     (void * ctx, void * ptr, size_t size);
+    void *  ctx;
+};
+
+
+// A read-only, non-owning slice of characters. Views are passed by value
+// and never allocate, a view into a cstring is only valid until that
+// cstring is modified or deleted
+struct _cstr_view_
+{
+    const char * ptr;
+    size_t       len;
+};
+
+// A set of characters compiled once by cstr_charset_of for the find_..._in
+// members, it can be reused for any number of searches over any cstring
+struct _cstr_charset_
+{
+    uint64_t bits[4];       // membership bit for each of the 256 character values
+    uint8_t  lo[2][16];     // low nibble rows used by the vector classifier
+};
+
 
 struct _cstr_iterator_
 {
@@ -87,27 +169,88 @@ struct _cstr_iterator_
 
 cstr_iterator cstr_itr(const short category);
 
+// Frees an iterator returned by cstr_itr, begin or rbegin
+const void    delete_itr(cstr_iterator itr);
+
+
+// A value iterator, a plain pointer into the string that can live on the stack
+// and never allocates. Reverse iterators point just past their character so
+// that rend never points before the start of the string. Like pointers they
+// are invalidated by any change to the length or capacity of the string
+struct _cstr_it_
+{
+    char *    ptr;
+    ptrdiff_t dir;      // 1 for forward iterators, -1 for reverse
+};
+
+// Dereferences the iterator in place
+static inline char *    cstr_it_ref     (cstr_it it)            { return it.ptr + (it.dir - 1) / 2; }
+static inline char      cstr_it_val     (cstr_it it)            { return *cstr_it_ref(it); }
+
+// Steps the iterator towards its end or back towards its beginning
+static inline void      cstr_it_inc     (cstr_it * it)          { it->ptr += it->dir; }
+static inline void      cstr_it_dec     (cstr_it * it)          { it->ptr -= it->dir; }
+
+// Tests whether two iterators refer to the same position
+static inline bool      cstr_it_equal   (cstr_it a, cstr_it b)  { return a.ptr == b.ptr; }
+
 
-// Initializes a new cstring and allocates function pointers
+// Initializes a new cstring and points it at the shared member functions
 // should no string be required at time of init then "" should be passed
 // passing a value of NULL will be treated effectively as ""
 cstring *   string(const char * init_str);
 
+// Initializes a new cstring from the first len characters of init_str,
+// which may contain null characters and need not be null terminated
+cstring *   string_n(const char * init_str, size_t len);
+
+// Initializes a new cstring like string_n whose memory, including the cstring
+// itself, comes from alloc. A NULL alloc uses malloc and free. The allocator
+// must outlive the cstring, returns NULL if the allocation fails
+cstring *   string_alloc(const char * init_str, size_t len, const cstr_allocator * alloc);
+
+// Initializes a new cstring holding the contents of the file at path. Large
+// files are memory mapped read only instead of being read, so nothing is
+// copied until the string is first modified, at which point the contents are
+// copied out into an ordinary string. Writing through data or an iterator
+// before that is not allowed. Returns NULL if the file cannot be read
+cstring *   string_map(const char * path);
+
+// Initializes a new cstring with the same contents as src in O(1) by sharing
+// its buffer, which stays read only until one of the strings is modified and
+// makes itself a private copy. The two may be used and deleted independently,
+// including on different threads. Short strings are copied instead. Writing
+// through an iterator of a shared string is not allowed
+cstring *   string_share(cstring * src);
+
 // Frees up the memory allocations for the cstring and allocates it to NULL
 // calls to cstring functions should not be found after this, runtime errors
 // will result if attempts are made
 const void  delete_string(cstring * );
 
-// CSTRING INTERFACE
-struct _cstring_
+// CSTRING METHODS
+// A single static table of these is shared by every cstring and reached through
+// its ops member, E.G. str->ops->find(str, "testing", NULL). Each member is also
+// available as a direct cstr_ function of the same name declared below
+struct _cstring_ops_
 {
-    cstr str;   // pointer to a string data type
-
     /* Modifiers */
 
     // Adds a string sequence to the end of the current string
     const   void        (*append)           (cstring * this, const char * str);
 
+    // Adds the first len characters of str to the end of the string,
+    // str may contain null characters
+    const   void        (*append_n)         (cstring * this, const char * str, size_t len);
+
+    // Adds the decimal text of a number to the end of the string, without
+    // going through snprintf except for about 0.5% of doubles. Doubles always
+    // read back to the same value and use the fewest digits that do so, the
+    // closest of those if there are several, E.G. 0.1 as "0.1" and 1e21 as "1e+21"
+    const   void        (*append_int)       (cstring * this, int64_t val);
+    const   void        (*append_uint)      (cstring * this, uint64_t val);
+    const   void        (*append_double)    (cstring * this, double val);
+
     // Adds a character to the end of the string
     const   void        (*push_back)        (cstring * this, const char chr);
 
@@ -117,11 +260,19 @@ struct _cstring_
     // Changes the string value to a new value
     const   void        (*assign)           (cstring * this, const char * str);
 
+    // Changes the string value to the first len characters of str,
+    // str may contain null characters
+    const   void        (*assign_n)         (cstring * this, const char * str, size_t len);
+
     // Inserts a string sequence into the string at any position
     // the sequence are inserted to the lhs of that position, any character
     // in that position will begin on the rhs of the the inserted string
     const   void        (*insert)           (cstring * this, size_t pos, const char * str);
 
+    // Inserts the first len characters of str at pos like insert,
+    // str may contain null characters
+    const   void        (*insert_n)         (cstring * this, size_t pos, const char * str, size_t len);
+
     // Erases a sequence of strings from the current string, a position
     // must be indicated at which to start from and the length of the erase
     const   void        (*erase)            (cstring * this, size_t pos, size_t len);
@@ -129,6 +280,10 @@ struct _cstring_
     // Swaps the contents of 2 cstring types
     const   void        (*swap)             (cstring * this, cstring * str);
 
+    // Changes the string value to that of str by sharing its buffer like
+    // string_share, which copies nothing until either string is modified
+    const   void        (*share)            (cstring * this, cstring * str);
+
     /* Element Access */
     // Retrieves the character at an element position, positions start at 0
     const   char        (*at)               (cstring * this, size_t pos);
@@ -156,6 +311,10 @@ struct _cstring_
     // size_t data type is optional and will store the position of the character proceeding result
     const   size_t      (*find)                 (cstring * this, const char * str, size_t * nxt_pos);
 
+    // Searches the string for the first len characters of str like find,
+    // str may contain null characters
+    const   size_t      (*find_n)               (cstring * this, const char * str, size_t len, size_t * nxt_pos);
+
     // Searches the string for the first character that matches ANY of the
     // characters specified in its arguments and returns the first match.
     // A starting position can be specified in which the search will begin from
@@ -176,6 +335,33 @@ struct _cstring_
     // A starting position can be specified in which the search will begin from
     const   size_t      (*find_last_not_of)     (cstring * this, const char * str, size_t pos);
 
+    // Versions of find_first_of, find_last_of, find_first_not_of and find_last_not_of
+    // that take a precompiled set of characters, see cstr_charset_of
+    const   size_t      (*find_first_in)        (cstring * this, const cstr_charset * set, size_t pos);
+    const   size_t      (*find_last_in)         (cstring * this, const cstr_charset * set, size_t pos);
+    const   size_t      (*find_first_not_in)    (cstring * this, const cstr_charset * set, size_t pos);
+    const   size_t      (*find_last_not_in)     (cstring * this, const cstr_charset * set, size_t pos);
+
+    // Searches the string for a precompiled needle like find, see cstr_pattern_new
+    const   size_t      (*find_pattern)         (cstring * this, cstr_pattern pat, size_t * nxt_pos);
+
+    // Finds every occurrence of a precompiled needle in a single pass, storing up to
+    // max positions in out, and returns the total number of occurrences found.
+    // When overlap is true occurrences may share characters, E.G. "aa" in "aaa" twice
+    const   size_t      (*find_all)             (cstring * this, cstr_pattern pat, size_t * out, size_t max, bool overlap);
+
+    // Finds every occurrence of every needle of a multi-needle automaton in a
+    // single pass, storing up to max hits in out in order of where they end,
+    // and returns the total number of hits found, see cstr_automaton_new
+    const   size_t      (*find_any)             (cstring * this, cstr_automaton ac, cstr_hit * out, size_t max);
+
+    // Splits the string at every character of set without copying, storing the
+    // tokens in out and returning how many were stored. At most max tokens are
+    // made, the last holding the rest of the string. When collapse is true empty
+    // tokens are skipped, E.G. "a,,b" on ',' gives "a", "b" instead of "a", "", "b".
+    // Tokens are only valid until the string is modified, see cstr_split_on
+    const   size_t      (*split)                (cstring * this, const cstr_charset * set, cstr_token * out, size_t max, bool collapse);
+
     // Returns a const char pointer to a string that is a subset of the cstring
     // this is a copy of the subset not a pointer to the subset in the cstring
     // A position must be specified at which the subset begins and the length to splice
@@ -185,6 +371,39 @@ struct _cstring_
     // strings must be an identical match (case sensitive)
     const   bool        (*compare)              (cstring * this, const char * str);
 
+    // Compares the cstring contents with the first len characters of str,
+    // str may contain null characters
+    const   bool        (*compare_n)            (cstring * this, const char * str, size_t len);
+
+    // Returns a view of the whole string without copying it
+    const   cstr_view   (*view)                 (cstring * this);
+
+    // Returns a view of the subset of the string starting at pos like substr,
+    // the view points into the cstring so nothing is copied or allocated
+    const   cstr_view   (*subview)              (cstring * this, size_t pos, size_t len);
+
+    // Versions of append, assign, insert, find and compare that take a view
+    const   void        (*append_view)          (cstring * this, cstr_view v);
+    const   void        (*assign_view)          (cstring * this, cstr_view v);
+    const   void        (*insert_view)          (cstring * this, size_t pos, cstr_view v);
+    const   size_t      (*find_view)            (cstring * this, cstr_view v, size_t * nxt_pos);
+    const   bool        (*compare_view)         (cstring * this, cstr_view v);
+
+    // Returns a fast non-cryptographic 64 bit hash of the contents (wyhash).
+    // The result is cached in the string and every modifier resets it, so
+    // hashing an unchanged string again is O(1). Writing through data or an
+    // iterator does not reset it. Equal contents always hash equal, including
+    // to cstr_view_hash of the same characters
+    const   uint64_t    (*hash)                 (cstring * this);
+
+    // Parses the number starting at pos in place, leading whitespace is skipped
+    // like strtol. Returns false and leaves out unchanged if there is no number
+    // there or it does not fit, otherwise end, when not NULL, is set to the
+    // position just past the number
+    const   bool        (*to_int)               (cstring * this, size_t pos, int64_t * out, size_t * end);
+    const   bool        (*to_uint)              (cstring * this, size_t pos, uint64_t * out, size_t * end);
+    const   bool        (*to_double)            (cstring * this, size_t pos, double * out, size_t * end);
+
 
     /* Capacity */
 
@@ -204,17 +423,27 @@ struct _cstring_
     // Tests for any non-null terminator characters in string
     const   bool        (*empty)            (cstring * this);
 
-    // Shrinks the string array by erasing trailing null character sequences
-    // this reduces the capacity to fit the size of the string
+    // Reduces the capacity to fit the size of the string, releasing spare memory.
+    // The contents are kept as they are, trailing null characters included,
+    // where the original version erased those and shortened the string
     const   void        (*shrink_to_fit)    (cstring * this);
 
+    // Number of characters the string can hold before it needs to reallocate
+    const   size_t      (*capacity)         (cstring * this);
+
+    // Pre-allocates room for at least n characters so that appends up to
+    // that length will not reallocate, never reduces the capacity
+    const   void        (*reserve)          (cstring * this, size_t n);
+
 
     /* Iterators */
 
     // Iterator pointer to start of string sequence, this is a forward iterator
+    // release it with delete_itr once finished
     cstr_iterator       (*begin)            (cstring * this);
 
     // Iterator pointer to end of string sequence, this is a reverse iterator
+    // release it with delete_itr once finished
     cstr_iterator       (*rbegin)           (cstring * this);
 
     // Iterator pointer to an indicator that sits after the string in memory
@@ -224,7 +453,561 @@ struct _cstring_
     // Iterator pointer to an indicator that sits before the string in memory
     // !! trying to dereference this will cause a runtime error
     cstr_iterator       (*rend)             (cstring * this);
+
+    // Value iterators to the first and one past the last character, and their
+    // reverse counterparts, see cstr_it. These never allocate
+    cstr_it             (*itr_begin)        (cstring * this);
+    cstr_it             (*itr_end)          (cstring * this);
+    cstr_it             (*itr_rbegin)       (cstring * this);
+    cstr_it             (*itr_rend)         (cstring * this);
+};
+
+// CSTRING INTERFACE
+struct _cstring_
+{
+    cstr str;                   // pointer to a string data type, points into sso for short strings
+    const cstring_ops * ops;    // member functions shared by all cstrings
+    const cstr_allocator * alloc;   // memory hooks, NULL for malloc and free
+
+    /* Storage */
+
+    // Inline storage for short strings, holds the header and up to
+    // CSTR_SSO_CAPACITY characters. A cstring must not be copied by value
+    // as str may point into its own storage
+    size_t sso[CSTR_SSO_HEADER + (CSTR_SSO_CAPACITY + sizeof(size_t)) / sizeof(size_t)];
+};
+
+
+/// DIRECT INTERFACE ///
+// Calls the cstring functions without going through the ops table, these
+// behave exactly like the ops member of the same name
+
+/* Modifiers */
+const   void        cstr_append             (cstring * this, const char * str);
+const   void        cstr_append_n           (cstring * this, const char * str, size_t len);
+const   void        cstr_append_int         (cstring * this, int64_t val);
+const   void        cstr_append_uint        (cstring * this, uint64_t val);
+const   void        cstr_append_double      (cstring * this, double val);
+const   void        cstr_push_back          (cstring * this, const char chr);
+const   void        cstr_pop_back           (cstring * this);
+const   void        cstr_assign             (cstring * this, const char * str);
+const   void        cstr_assign_n           (cstring * this, const char * str, size_t len);
+const   void        cstr_insert             (cstring * this, size_t pos, const char * str);
+const   void        cstr_insert_n           (cstring * this, size_t pos, const char * str, size_t len);
+const   void        cstr_erase              (cstring * this, size_t pos, size_t len);
+const   void        cstr_swap               (cstring * this, cstring * str);
+const   void        cstr_share              (cstring * this, cstring * str);
+
+/* Element Access */
+const   char        cstr_at                 (cstring * this, size_t pos);
+const   char        cstr_back               (cstring * this);
+const   char        cstr_front              (cstring * this);
+
+/* String Operations */
+const   char *      cstr_data               (cstring * this);
+const   size_t      cstr_copy               (cstring * this, char ** buf, size_t pos, size_t len);
+const   size_t      cstr_find               (cstring * this, const char * str, size_t * nxt_pos);
+const   size_t      cstr_find_n             (cstring * this, const char * str, size_t len, size_t * nxt_pos);
+const   size_t      cstr_find_first_of      (cstring * this, const char * str, size_t pos);
+const   size_t      cstr_find_last_of       (cstring * this, const char * str, size_t pos);
+const   size_t      cstr_find_first_not_of  (cstring * this, const char * str, size_t pos);
+const   size_t      cstr_find_last_not_of   (cstring * this, const char * str, size_t pos);
+const   size_t      cstr_find_first_in      (cstring * this, const cstr_charset * set, size_t pos);
+const   size_t      cstr_find_last_in       (cstring * this, const cstr_charset * set, size_t pos);
+const   size_t      cstr_find_first_not_in  (cstring * this, const cstr_charset * set, size_t pos);
+const   size_t      cstr_find_last_not_in   (cstring * this, const cstr_charset * set, size_t pos);
+const   size_t      cstr_find_pattern       (cstring * this, cstr_pattern pat, size_t * nxt_pos);
+const   size_t      cstr_find_all           (cstring * this, cstr_pattern pat, size_t * out, size_t max, bool overlap);
+const   size_t      cstr_find_any           (cstring * this, cstr_automaton ac, cstr_hit * out, size_t max);
+const   size_t      cstr_split_into         (cstring * this, const cstr_charset * set, cstr_token * out, size_t max, bool collapse);    // the split member
+const   char *      cstr_substr             (cstring * this, size_t pos, size_t len);
+const   bool        cstr_compare            (cstring * this, const char * str);
+const   bool        cstr_compare_n          (cstring * this, const char * str, size_t len);
+const   cstr_view   cstr_view_of            (cstring * this);    // the view member
+const   cstr_view   cstr_subview            (cstring * this, size_t pos, size_t len);
+const   void        cstr_append_view        (cstring * this, cstr_view v);
+const   void        cstr_assign_view        (cstring * this, cstr_view v);
+const   void        cstr_insert_view        (cstring * this, size_t pos, cstr_view v);
+const   size_t      cstr_find_view          (cstring * this, cstr_view v, size_t * nxt_pos);
+const   bool        cstr_compare_view       (cstring * this, cstr_view v);
+const   uint64_t    cstr_hash               (cstring * this);
+const   bool        cstr_to_int             (cstring * this, size_t pos, int64_t * out, size_t * end);
+const   bool        cstr_to_uint            (cstring * this, size_t pos, uint64_t * out, size_t * end);
+const   bool        cstr_to_double          (cstring * this, size_t pos, double * out, size_t * end);
+
+/* Capacity */
+const   size_t      cstr_length             (cstring * this);
+const   size_t      cstr_max_size           (cstring * this);
+const   size_t      cstr_resize             (cstring * this, size_t new_size);
+const   void        cstr_clear              (cstring * this);
+const   bool        cstr_empty              (cstring * this);
+const   void        cstr_shrink_to_fit      (cstring * this);
+const   size_t      cstr_capacity           (cstring * this);
+const   void        cstr_reserve            (cstring * this, size_t n);
+
+/* Iterators */
+cstr_iterator       cstr_begin              (cstring * this);
+cstr_iterator       cstr_rbegin             (cstring * this);
+cstr_iterator       cstr_end                (cstring * this);
+cstr_iterator       cstr_rend               (cstring * this);
+cstr_it             cstr_itr_begin          (cstring * this);
+cstr_it             cstr_itr_end            (cstring * this);
+cstr_it             cstr_itr_rbegin         (cstring * this);
+cstr_it             cstr_itr_rend           (cstring * this);
+
+
+/// CSTR_VIEW INTERFACE ///
+
+// Makes a view of a null terminated string, NULL gives an empty view
+cstr_view   cstr_view_from          (const char * str);
+
+// Makes a view of the first len characters at ptr
+cstr_view   cstr_view_n             (const char * ptr, size_t len);
+
+// Returns the position of the first occurrence of needle at or after pos, or npos
+size_t      cstr_view_find          (cstr_view v, cstr_view needle, size_t pos);
+
+// Tests two views for identical contents (case sensitive)
+bool        cstr_view_compare       (cstr_view v, cstr_view other);
+
+// Returns the view of up to len characters starting at pos, clamped to the
+// end of v. A pos past the end gives an empty view
+cstr_view   cstr_view_substr        (cstr_view v, size_t pos, size_t len);
+
+// Tests whether v begins or ends with the given characters
+bool        cstr_view_starts_with   (cstr_view v, cstr_view prefix);
+bool        cstr_view_ends_with     (cstr_view v, cstr_view suffix);
+
+// Hashes the characters of v, the same function as the cstring hash member
+uint64_t    cstr_view_hash          (cstr_view v);
+
+// Parses the number at the start of v like the cstring to_ members, used,
+// when not NULL, is set to the number of characters consumed
+bool        cstr_view_to_int        (cstr_view v, int64_t * out, size_t * used);
+bool        cstr_view_to_uint       (cstr_view v, uint64_t * out, size_t * used);
+bool        cstr_view_to_double     (cstr_view v, double * out, size_t * used);
+
+
+/// CSTR_CHARSET INTERFACE ///
+
+// Compiles the characters of a null terminated string into a set
+cstr_charset    cstr_charset_of     (const char * chars);
+
+// Compiles the first len characters at chars into a set, null characters included
+cstr_charset    cstr_charset_n      (const char * chars, size_t len);
+
+// Tests whether c is a member of the set
+bool            cstr_charset_has    (const cstr_charset * set, char c);
+
+
+/// CSTR_PATTERN INTERFACE ///
+
+// Match iterator over one haystack, see cstr_pattern_matches
+struct _cstr_matches_
+{
+    cstr_pattern pat;
+    cstr_view    hay;
+    size_t       pos;       // where the next search begins
+    bool         overlap;
 };
 
+// Compiles a needle for repeated searching, the search algorithm is chosen by
+// its length (Boyer-Moore-Horspool for short needles, Two-Way for long ones).
+// A pattern holds its own copy of the needle and can be shared by any number
+// of searches, returns NULL for an empty needle
+cstr_pattern    cstr_pattern_new        (const char * needle);
+cstr_pattern    cstr_pattern_n          (const char * needle, size_t len);
+
+// Frees a compiled needle
+void            cstr_pattern_delete     (cstr_pattern pat);
+
+// Length of the compiled needle
+size_t          cstr_pattern_length     (cstr_pattern pat);
+
+// Returns the position of the first occurrence of the needle in v at or after pos, or npos
+size_t          cstr_pattern_find       (cstr_pattern pat, cstr_view v, size_t pos);
+
+// Starts iterating over every occurrence of the needle in v
+cstr_matches    cstr_pattern_matches    (cstr_pattern pat, cstr_view v, bool overlap);
+
+// Stores the position of the next occurrence in pos and returns true,
+// or returns false once there are no more
+bool            cstr_matches_next       (cstr_matches * it, size_t * pos);
+
+
+/// CSTR_AUTOMATON INTERFACE ///
+
+// One occurrence of a needle found by an automaton
+struct _cstr_hit_
+{
+    size_t id;      // index of the needle in the list the automaton was built from
+    size_t pos;     // position of the first character of the occurrence
+};
+
+// Builds an Aho-Corasick automaton that finds any of count needles in a single
+// pass over a string. The transitions are stored as one dense table over the
+// characters the needles use, so each character scanned costs a single lookup.
+// Empty or NULL needles never match, returns NULL if it cannot be allocated
+cstr_automaton  cstr_automaton_new      (const char * const * needles, size_t count);
+cstr_automaton  cstr_automaton_n        (const cstr_view * needles, size_t count);
+
+// Frees an automaton
+void            cstr_automaton_delete   (cstr_automaton ac);
+
+// Calls fn for every occurrence of every needle in v in order of where they
+// end, stopping early if fn returns false. Returns the number of calls made
+size_t          cstr_automaton_each     (cstr_automaton ac, cstr_view v,
+                                         bool (*fn)(void * ctx, cstr_hit hit), void * ctx);
+
+// Stores up to max hits in out and returns the total number of hits in v
+size_t          cstr_automaton_scan     (cstr_automaton ac, cstr_view v, cstr_hit * out, size_t max);
+
+
+/// CSTR_SPLIT INTERFACE ///
+
+// One field of a split string, the characters at pos up to pos + len
+struct _cstr_token_
+{
+    size_t pos;
+    size_t len;
+};
+
+// Token iterator over one string, see cstr_split_on
+struct _cstr_split_
+{
+    cstr_view    hay;
+    cstr_view    delim;     // string delimiter, empty when splitting on set
+    cstr_charset set;       // delimiter characters
+    int          chr;       // the only delimiter character, or -1
+    size_t       pos;       // where the next token begins, past the end once done
+    size_t       max;       // tokens left before the rest is taken whole, 0 for no limit
+    bool         collapse;  // skip empty tokens
+};
+
+// Starts splitting v on a single character, any character of a set, or a whole
+// delimiter string. Delimiters are found with the vectorized scanners used by
+// the find members and tokens point into v, nothing is copied. max and collapse
+// are as for the split member with a max of 0 giving no limit. An empty
+// string delimiter never matches, so v is returned as one token
+cstr_split      cstr_split_on_char      (cstr_view v, char delim, size_t max, bool collapse);
+cstr_split      cstr_split_on           (cstr_view v, const cstr_charset * set, size_t max, bool collapse);
+cstr_split      cstr_split_on_str       (cstr_view v, cstr_view delim, size_t max, bool collapse);
+
+// Stores the next token in tok and returns true, or returns false once there are no more
+bool            cstr_split_next         (cstr_split * it, cstr_token * tok);
+
+// Stores up to max of the remaining tokens in out and returns how many were stored
+size_t          cstr_split_all          (cstr_split * it, cstr_token * out, size_t max);
+
+// Returns a view of the characters of a token
+cstr_view       cstr_token_view         (cstr_view v, cstr_token tok);
+
+
+/// CSTR_STREAM INTERFACE ///
+// Searches input that cannot be held in memory, E.G. pipes and sockets. The
+// input is read chunk bytes at a time into one reusable buffer, keeping the
+// last needle length - 1 bytes of each chunk so occurrences that straddle two
+// reads are still found. Memory use stays at about chunk bytes whatever the
+// input size. The stream does not own the pattern, descriptor or FILE
+
+// Starts searching a file descriptor or FILE for pat, a chunk of 0 uses CSTR_STREAM_CHUNK
+cstr_stream     cstr_stream_fd          (int fd, cstr_pattern pat, size_t chunk);
+cstr_stream     cstr_stream_file        (FILE * file, cstr_pattern pat, size_t chunk);
+
+// Stores the offset from the start of the stream of the next occurrence in
+// offset and returns true, or returns false at the end of the input.
+// Occurrences do not overlap, like cstr_pattern_matches without overlap
+bool            cstr_stream_next        (cstr_stream s, uint64_t * offset);
+
+// True if reading the input failed, as opposed to reaching its end
+bool            cstr_stream_error       (cstr_stream s);
+
+// Frees the stream and its buffer
+void            cstr_stream_delete      (cstr_stream s);
+
+
+/// CSTR_POOL INTERFACE ///
+// An interning pool keeps one canonical cstring for each distinct contents, so
+// strings interned in the same pool are equal exactly when their pointers are
+// and every copy shares the same memory. Any number of threads may intern into
+// one pool at once. Strings already in the pool are found without locking,
+// only adding a new string takes the pool's lock
+
+// Creates an empty pool
+cstr_pool       cstr_pool_new           (void);
+
+// Frees the pool and every string interned in it
+void            cstr_pool_delete        (cstr_pool pool);
+
+// Returns the canonical cstring with the given contents, adding it to the
+// pool the first time. The result belongs to the pool and lives as long as it,
+// it must not be modified or deleted. Returns NULL if it cannot be allocated
+cstring *       cstr_intern             (cstr_pool pool, const char * str);
+cstring *       cstr_intern_n           (cstr_pool pool, const char * str, size_t len);
+cstring *       cstr_intern_view        (cstr_pool pool, cstr_view v);
+cstring *       cstr_intern_string      (cstr_pool pool, cstring * str);
+
+// Returns the canonical cstring with the given contents only if it is
+// already in the pool, otherwise NULL. Never locks
+cstring *       cstr_pool_lookup        (cstr_pool pool, cstr_view v);
+
+// Number of distinct strings in the pool
+size_t          cstr_pool_size          (cstr_pool pool);
+
+
+/// CSTR_MAP INTERFACE ///
+// A hash map from strings to pointers laid out as one flat table. Each slot has
+// a control byte holding 7 bits of its key's hash and slots are probed 16 at a
+// time, so a lookup usually compares a single key, and the full hash of every
+// key is stored alongside it to rule out the rest before reading any
+// characters. Lookups take a view, E.G. cstr_map_get(m, cstr_view_from("key"), &val),
+// so no cstring needs to be built to search the map. The map keeps its own
+// copies of the keys. A map is not thread safe
+
+// Creates an empty map with room for about cap entries before it grows
+cstr_map        cstr_map_new            (size_t cap);
+
+// Frees the map and its keys, the values are left to the caller
+void            cstr_map_delete         (cstr_map m);
+
+// Number of entries in the map
+size_t          cstr_map_size           (cstr_map m);
+
+// Sets the value of key, adding the key if it is not in the map yet.
+// Returns false if the map could not grow
+bool            cstr_map_put            (cstr_map m, cstr_view key, void * val);
+bool            cstr_map_put_string     (cstr_map m, cstring * key, void * val);
+
+// Stores the value of key in val, when not NULL, and returns true,
+// or returns false if key is not in the map
+bool            cstr_map_get            (cstr_map m, cstr_view key, void ** val);
+bool            cstr_map_get_string     (cstr_map m, cstring * key, void ** val);
+
+// Removes key from the map, returns false if it was not there
+bool            cstr_map_remove         (cstr_map m, cstr_view key);
+
+// Iterates over the entries in no particular order. pos must start at 0,
+// returns false after the last entry. The map must not change meanwhile
+bool            cstr_map_next           (cstr_map m, size_t * pos, cstring ** key, void ** val);
+
+
+/// CSTR_WORKERS INTERFACE ///
+// Searches very large strings on several cores. The string is cut into chunks
+// that a pool of worker threads takes in turn, occurrences that straddle two
+// chunks are still found and every result is exactly what the single threaded
+// member of the same name returns. A pool runs one search at a time, calls
+// from other threads wait their turn. A NULL pool searches on the calling
+// thread alone
+
+// Starts threads - 1 workers, the calling thread making up the last one, a
+// threads of 0 uses one per online CPU. Each worker takes chunk characters at
+// a time, 0 for CSTR_PAR_CHUNK
+cstr_workers    cstr_workers_new        (size_t threads, size_t chunk);
+
+// Stops the workers and frees the pool
+void            cstr_workers_delete     (cstr_workers w);
+
+// Parallel cstr_find_pattern searching from pos, the lowest position of pat
+// at or after it, or npos
+size_t          cstr_par_find           (cstr_workers w, cstring * str, cstr_pattern pat, size_t pos);
+
+// Number of occurrences of pat, counted like cstr_find_all. A needle that
+// overlaps itself so much that more than CSTR_PAR_STARTS occurrences begin
+// within a needle length of a chunk start is counted on the calling thread
+size_t          cstr_par_count          (cstr_workers w, cstring * str, cstr_pattern pat, bool overlap);
+
+// Parallel cstr_find_all, storing the first max positions in out in order
+size_t          cstr_par_find_all       (cstr_workers w, cstring * str, cstr_pattern pat,
+                                         size_t * out, size_t max, bool overlap);
+
+// Parallel cstr_find_first_in, the lowest position at or after pos of a
+// character in set, or npos
+size_t          cstr_par_find_first_in  (cstr_workers w, cstring * str, const cstr_charset * set, size_t pos);
+
+
+/// CSTR_BATCH INTERFACE ///
+// Runs one operation over a whole array of strings, reading ahead so the
+// headers and first characters of later strings are already in cache. Arrays
+// of more than a few thousand strings are split over the pool w, a NULL pool
+// works through them on the calling thread. NULL entries count as empty
+// strings. A string may only appear once in an array given to cstr_batch_hash,
+// which caches the result in each string, or to cstr_batch_fold
+
+// out[i] is the length of strs[i]
+void    cstr_batch_length       (cstr_workers w, cstring * const * strs, size_t n, size_t * out);
+
+// out[i] is cstr_hash of strs[i]
+void    cstr_batch_hash         (cstr_workers w, cstring * const * strs, size_t n, uint64_t * out);
+
+// out[i] is whether strs[i] holds exactly the characters of with, returns the
+// number that do. out may be NULL when only the number is wanted
+size_t  cstr_batch_compare      (cstr_workers w, cstring * const * strs, size_t n, cstr_view with, bool * out);
+
+// out[i] is the first position of pat in strs[i] or npos, returns the number
+// of strings that contain it. out may be NULL when only the number is wanted
+size_t  cstr_batch_find         (cstr_workers w, cstring * const * strs, size_t n, cstr_pattern pat, size_t * out);
+
+// Lowers the ASCII letters of every string in place, other bytes are untouched
+void    cstr_batch_fold         (cstr_workers w, cstring * const * strs, size_t n);
+
+// The same over arrays of views
+void    cstr_batch_view_hash    (cstr_workers w, const cstr_view * views, size_t n, uint64_t * out);
+size_t  cstr_batch_view_compare (cstr_workers w, const cstr_view * views, size_t n, cstr_view with, bool * out);
+size_t  cstr_batch_view_find    (cstr_workers w, const cstr_view * views, size_t n, cstr_pattern pat, size_t * out);
+
+
+/// CSTR_ARENA INTERFACE ///
+// A bump allocator for strings that share a lifetime, E.G. everything built while
+// handling one request. Allocation takes memory from the end of the current
+// block and nothing is returned until the whole arena is reset. An arena is
+// not thread safe, give each thread its own
+
+// Creates an arena that allocates blocks of block_size bytes, 0 for CSTR_ARENA_BLOCK
+cstr_arena              cstr_arena_new          (size_t block_size);
+
+// The hooks to pass to string_alloc for cstrings that live in the arena
+const cstr_allocator *  cstr_arena_allocator    (cstr_arena arena);
+
+// Releases every cstring allocated from the arena at once, keeping its first
+// block for reuse. Those cstrings must not be used or deleted afterwards
+void                    cstr_arena_reset        (cstr_arena arena);
+
+// Releases every cstring allocated from the arena and the arena itself
+void                    cstr_arena_delete       (cstr_arena arena);
+
+
+/// CSTR_ROPE INTERFACE ///
+// A string for large documents that are edited in the middle. The text is held
+// as a balanced tree of pieces so insert and erase cost O(log n) instead of
+// moving the whole buffer. Positions and lengths follow the cstring members of
+// the same name, and the text is only made contiguous when data is called
+
+// Creates a rope holding a copy of init_str, NULL is treated as ""
+cstr_rope       cstr_rope_new       (const char * init_str);
+cstr_rope       cstr_rope_n         (const char * init_str, size_t len);
+
+// Frees the rope and all of its text
+void            cstr_rope_delete    (cstr_rope rope);
+
+// Number of characters in the rope
+size_t          cstr_rope_length    (cstr_rope rope);
+
+// Inserts a string sequence into the rope at pos, pos must not be past the end
+void            cstr_rope_insert    (cstr_rope rope, size_t pos, const char * str);
+void            cstr_rope_insert_n  (cstr_rope rope, size_t pos, const char * str, size_t len);
+
+// Erases up to len characters starting at pos
+void            cstr_rope_erase     (cstr_rope rope, size_t pos, size_t len);
+
+// Retrieves the character at pos, '\0' when pos is past the end
+char            cstr_rope_at        (cstr_rope rope, size_t pos);
+
+// Searches the rope like the cstring find member, matches may span pieces
+size_t          cstr_rope_find      (cstr_rope rope, const char * str, size_t * nxt_pos);
+size_t          cstr_rope_find_n    (cstr_rope rope, const char * str, size_t len, size_t * nxt_pos);
+
+// Returns a dynamically allocated copy of up to len characters starting at pos,
+// which the caller must free, or NULL when pos is past the end
+char *          cstr_rope_substr    (cstr_rope rope, size_t pos, size_t len);
+
+// Calls fn with each contiguous piece of the rope in order, stopping early
+// if fn returns false
+void            cstr_rope_each      (cstr_rope rope, bool (*fn)(void * ctx, const char * piece, size_t len), void * ctx);
+
+// Joins the pieces into one null terminated buffer and returns it, the
+// pointer is valid until the rope is next modified or deleted
+const char *    cstr_rope_data      (cstr_rope rope);
+
+
+/// CSTRING_BUILDER INTERFACE ///
+// Assembles a cstring from many fragments. Each call writes straight into the
+// spare capacity of one growing buffer, and finish hands that buffer over as
+// a cstring without a final copy. If any step fails to allocate the builder
+// remembers it and finish returns NULL, so callers only check once at the end
+
+// Creates a builder with room for at least cap characters before it grows
+cstring_builder cstr_builder_new        (size_t cap);
+
+// Creates a builder like cstr_builder_new whose cstring uses alloc, see string_alloc
+cstring_builder cstr_builder_alloc      (size_t cap, const cstr_allocator * alloc);
+
+// Ensures at least cap characters in total fit without growing again
+void            cstr_builder_reserve    (cstring_builder b, size_t cap);
+
+// Appends a string sequence to the end of the builder
+void            cstr_builder_append     (cstring_builder b, const char * str);
+void            cstr_builder_append_n   (cstring_builder b, const char * str, size_t len);
+void            cstr_builder_append_view(cstring_builder b, cstr_view v);
+
+// Appends count views, growing at most once for all of them
+void            cstr_builder_append_all (cstring_builder b, const cstr_view * parts, size_t count);
+
+// Appends every string argument up to a terminating NULL, growing at most once
+// E.G. cstr_builder_concat(b, "<", tag, ">", NULL);
+void            cstr_builder_concat     (cstring_builder b, ...);
+
+// Appends printf style formatted output, written directly into spare capacity
+void            cstr_builder_appendf    (cstring_builder b, const char * fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void            cstr_builder_vappendf   (cstring_builder b, const char * fmt, va_list args);
+
+// Number of characters appended so far
+size_t          cstr_builder_length     (cstring_builder b);
+
+// Returns the characters appended so far, valid until the next append
+const char *    cstr_builder_data       (cstring_builder b);
+
+// True if every step so far has succeeded
+bool            cstr_builder_ok         (cstring_builder b);
+
+// Frees the builder and returns its buffer as a cstring, to be released
+// with delete_string. Returns NULL if any earlier step failed
+cstring *       cstr_builder_finish     (cstring_builder b);
+
+// Frees the builder and everything appended to it
+void            cstr_builder_delete     (cstring_builder b);
+
+/// LEGACY MEMBERS ///
+// The members a cstring carried before they moved to the ops table, so that
+// str->find(str, ...) style callers build unchanged. Each old member name is
+// a macro for its ops member, so str->find becomes str->ops->find and the
+// layout of a cstring is the same in every build. The names are taken over
+// for the rest of the translation unit, include this file after any other
+// headers. A local variable or field named E.G. length fails to compile
+// rather than silently changing meaning
+#ifdef CSTR_LEGACY_MEMBERS
+#define append             ops->append
+#define push_back          ops->push_back
+#define pop_back           ops->pop_back
+#define assign             ops->assign
+#define insert             ops->insert
+#define erase              ops->erase
+#define swap               ops->swap
+#define at                 ops->at
+#define back               ops->back
+#define front              ops->front
+#define data               ops->data
+#define copy               ops->copy
+#define find               ops->find
+#define find_first_of      ops->find_first_of
+#define find_last_of       ops->find_last_of
+#define find_first_not_of  ops->find_first_not_of
+#define find_last_not_of   ops->find_last_not_of
+#define substr             ops->substr
+#define compare            ops->compare
+#define length             ops->length
+#define max_size           ops->max_size
+#define resize             ops->resize
+#define clear              ops->clear
+#define empty              ops->empty
+#define shrink_to_fit      ops->shrink_to_fit
+#define begin              ops->begin
+#define rbegin             ops->rbegin
+#define end                ops->end
+#define rend               ops->rend
+#endif
 
 #endif
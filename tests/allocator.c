@@ -0,0 +1,148 @@
+// Allocator hooks: every byte a string takes goes through the hooks it was
+// made with and comes back with the size it was allocated at, and strings in
+// an arena hold the same contents as plain char buffers until it is reset
+//
+//   cc -std=gnu11 -I.. allocator.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define STRINGS 16
+
+// each block carries its size in front so that free can check it
+struct counter { size_t live; size_t calls; };
+
+static void * hook_alloc(void * ctx, size_t size)
+{
+    struct counter * c = ctx;
+    size_t * p = malloc(size + sizeof(size_t));
+    if(p == NULL)
+        return NULL;
+    *p = size;
+    c->live += size;
+    c->calls++;
+    return p + 1;
+}
+
+static void hook_free(void * ctx, void * ptr, size_t size)
+{
+    struct counter * c = ctx;
+    size_t * p = (size_t *)ptr - 1;
+    CHECK(*p == size);
+    c->live -= size;
+    free(p);
+}
+
+static void * hook_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    void * p = hook_alloc(ctx, new_size);
+    if(p != NULL)
+    {
+        memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+        hook_free(ctx, ptr, old_size);
+    }
+    return p;
+}
+
+static char model[STRINGS][4096];
+static size_t size[STRINGS];
+
+// a random edit to string i and its model
+static void edit(cstring * s, int i)
+{
+    char buf[40];
+    size_t len = rnd() % sizeof(buf), pos = rnd() % (size[i] + 1);
+    for(size_t k = 0; k < len; k++)
+        buf[k] = 'a' + rnd() % 26;
+
+    switch(size[i] > 3000 ? 0 : rnd() % 4)
+    {
+    case 0:
+        memcpy(model[i], buf, len);
+        size[i] = len;
+        cstr_assign_n(s, buf, len);
+        break;
+    case 1:
+        memmove(model[i] + pos + len, model[i] + pos, size[i] - pos);
+        memcpy(model[i] + pos, buf, len);
+        size[i] += len;
+        cstr_insert_n(s, pos, buf, len);
+        break;
+    default:
+        memcpy(model[i] + size[i], buf, len);
+        size[i] += len;
+        cstr_append_n(s, buf, len);
+        break;
+    }
+}
+
+int main(void)
+{
+    struct counter one = { 0, 0 }, two = { 0, 0 };
+    const cstr_allocator a = { &hook_alloc, &hook_realloc, &hook_free, &one };
+    const cstr_allocator b = { &hook_alloc, &hook_realloc, &hook_free, &two };
+    cstring * s[STRINGS];
+
+    // every string's memory is accounted to its own hooks
+    for(int i = 0; i < STRINGS; i++)
+    {
+        s[i] = string_alloc("", 0, i % 2 ? &a : &b);
+        size[i] = 0;
+    }
+    for(int r = 0; r < 20000; r++)
+    {
+        int i = rnd() % STRINGS;
+        edit(s[i], i);
+        CHECK(cstr_length(s[i]) == size[i] && memcmp(cstr_data(s[i]), model[i], size[i]) == 0);
+
+        // swaps between the two allocators exchange contents, not blocks
+        int j = rnd() % STRINGS;
+        if(r % 97 == 0 && j != i)
+        {
+            char tmp[4096];
+            size_t n = size[i];
+            memcpy(tmp, model[i], n);
+            memcpy(model[i], model[j], size[j]);
+            size[i] = size[j];
+            memcpy(model[j], tmp, n);
+            size[j] = n;
+            cstr_swap(s[i], s[j]);
+        }
+    }
+    CHECK(one.calls > 0 && two.calls > 0);
+    for(int i = 0; i < STRINGS; i++)
+    {
+        CHECK(cstr_length(s[i]) == size[i] && memcmp(cstr_data(s[i]), model[i], size[i]) == 0);
+        delete_string(s[i]);
+    }
+    CHECK(one.live == 0 && two.live == 0);
+
+    // an arena, reset and reused a few times
+    cstr_arena arena = cstr_arena_new(1000);
+    for(int round = 0; round < 5; round++)
+    {
+        for(int i = 0; i < STRINGS; i++)
+        {
+            s[i] = string_alloc("", 0, cstr_arena_allocator(arena));
+            size[i] = 0;
+        }
+        for(int r = 0; r < 5000; r++)
+        {
+            int i = rnd() % STRINGS;
+            edit(s[i], i);
+        }
+        for(int i = 0; i < STRINGS; i++)
+        {
+            CHECK(cstr_length(s[i]) == size[i] && memcmp(cstr_data(s[i]), model[i], size[i]) == 0);
+            CHECK(cstr_data(s[i])[size[i]] == '\0');
+        }
+
+        // deleting some individually before the reset is allowed
+        delete_string(s[0]);
+        delete_string(s[1]);
+        cstr_arena_reset(arena);
+    }
+    cstr_arena_delete(arena);
+
+    return done();
+}
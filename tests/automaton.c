@@ -0,0 +1,103 @@
+// Multi-needle search against trying every needle at every position, over
+// small alphabets where needles are often prefixes or suffixes of each other
+//
+//   cc -std=gnu11 -I.. automaton.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define NEEDLES 12
+#define HITS    (600 * NEEDLES)
+
+static int by_pos(const void * a, const void * b)
+{
+    const cstr_hit * x = a, * y = b;
+    // ties between hits that end together, by pos then id
+    if(x->pos != y->pos)
+        return x->pos < y->pos ? -1 : 1;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static size_t lens[NEEDLES];
+
+static size_t end_of(cstr_hit h)
+{
+    return h.pos + lens[h.id];
+}
+
+static bool stop_after_three(void * ctx, cstr_hit hit)
+{
+    (void)hit;
+    return ++*(int *)ctx < 3;
+}
+
+static int sort_hits(const void * a, const void * b)
+{
+    const cstr_hit * x = a, * y = b;
+    if(end_of(*x) != end_of(*y))
+        return end_of(*x) < end_of(*y) ? -1 : 1;
+    return by_pos(a, b);
+}
+
+int main(void)
+{
+    static cstr_hit want[HITS], got[HITS];
+    char hay[600], store[NEEDLES][8];
+
+    for(int i = 0; i < 5000; i++)
+    {
+        int alpha = 1 + rnd() % 4;
+        size_t n = rnd() % sizeof(hay), count = 1 + rnd() % NEEDLES;
+        for(size_t k = 0; k < n; k++)
+            hay[k] = 'a' + rnd() % alpha;
+
+        cstr_view needles[NEEDLES];
+        for(size_t j = 0; j < count; j++)
+        {
+            // an occasional empty needle, which never matches
+            lens[j] = rnd() % 16 ? 1 + rnd() % 7 : 0;
+            for(size_t k = 0; k < lens[j]; k++)
+                store[j][k] = 'a' + rnd() % alpha;
+            needles[j] = cstr_view_n(store[j], lens[j]);
+        }
+
+        size_t total = 0;
+        for(size_t p = 0; p < n; p++)
+            for(size_t j = 0; j < count; j++)
+                if(lens[j] && p + lens[j] <= n && memcmp(hay + p, store[j], lens[j]) == 0)
+                {
+                    want[total].id = j;
+                    want[total++].pos = p;
+                }
+        qsort(want, total, sizeof(cstr_hit), &sort_hits);
+
+        cstr_automaton ac = cstr_automaton_n(needles, count);
+        CHECK(ac != NULL);
+
+        size_t max = rnd() % 2 ? HITS : rnd() % (total + 1);
+        size_t found = cstr_automaton_scan(ac, cstr_view_n(hay, n), got, max);
+        CHECK(found == total);
+
+        // hits come out in order of where they end, the order among those
+        // that end together is up to the automaton
+        size_t stored = found < max ? found : max;
+        for(size_t k = 1; k < stored; k++)
+            CHECK(end_of(got[k - 1]) <= end_of(got[k]));
+        if(stored == total)
+        {
+            qsort(got, stored, sizeof(cstr_hit), &sort_hits);
+            CHECK(memcmp(got, want, total * sizeof(cstr_hit)) == 0);
+        }
+
+        cstring * s = string_n(hay, n);
+        CHECK(cstr_find_any(s, ac, got, HITS) == total);
+        delete_string(s);
+
+        int calls = 0;
+        CHECK(cstr_automaton_each(ac, cstr_view_n(hay, n), &stop_after_three, &calls) == (total < 3 ? total : 3));
+
+        cstr_automaton_delete(ac);
+    }
+
+    return done();
+}
@@ -0,0 +1,156 @@
+// Every batch operation against the same operation done one string at a time
+// with plain loops, on arrays short enough to stay on the calling thread and
+// long enough to be split over a pool, NULL entries and embedded NULs included
+//
+//   cc -std=gnu11 -I.. batch.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static size_t naive_find(const char * h, size_t n, const char * p, size_t len)
+{
+    for(size_t i = 0; i + len <= n; i++)
+        if(memcmp(h + i, p, len) == 0)
+            return i;
+    return npos;
+}
+
+static uint64_t fresh(const char * p, size_t len)
+{
+    cstring * t = string_n(p, len);
+    uint64_t h = cstr_hash(t);
+    delete_string(t);
+    return h;
+}
+
+static void check_all(cstr_workers w, size_t n)
+{
+    cstring ** strs = malloc(n * sizeof(*strs));
+    cstr_view * views = malloc(n * sizeof(*views));
+    char ** copy = malloc(n * sizeof(*copy));
+    size_t * lens = malloc(n * sizeof(size_t));
+    size_t * pos = malloc(n * sizeof(size_t));
+    uint64_t * hash = malloc(n * sizeof(uint64_t));
+    bool * eq = malloc(n * sizeof(bool));
+
+    char with[] = "aB\0c";
+    char needle[] = "Ba";
+
+    for(size_t i = 0; i < n; i++)
+    {
+        // mostly short strings over a small alphabet so that equal strings
+        // and hits are common, now and then one past the inline capacity
+        size_t len = rnd() % 8 ? rnd() % 6 : rnd() % 100;
+        copy[i] = malloc(len + 1);
+        for(size_t k = 0; k < len; k++)
+            copy[i][k] = "aBbAc\0"[rnd() % 6];
+        if(rnd() % 4 == 0 && len >= 4)
+            memcpy(copy[i], with, 4);
+
+        lens[i] = len;
+        strs[i] = rnd() % 50 ? string_n(copy[i], len) : NULL;
+        views[i] = cstr_view_n(copy[i], len);
+        if(strs[i] == NULL)
+            lens[i] = 0;
+    }
+
+    // lengths
+    cstr_batch_length(w, strs, n, pos);
+    for(size_t i = 0; i < n; i++)
+        CHECK(pos[i] == lens[i]);
+
+    // hashes, of the strings and of the views over the same characters
+    cstr_batch_hash(w, strs, n, hash);
+    for(size_t i = 0; i < n; i++)
+        CHECK(hash[i] == fresh(copy[i], lens[i]));
+
+    cstr_batch_view_hash(w, views, n, hash);
+    for(size_t i = 0; i < n; i++)
+        CHECK(hash[i] == fresh(copy[i], views[i].len));
+
+    // comparisons, with and without out
+    cstr_view v = cstr_view_n(with, 4);
+    size_t same = 0, vsame = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        same += lens[i] == 4 && memcmp(copy[i], with, 4) == 0;
+        vsame += views[i].len == 4 && memcmp(copy[i], with, 4) == 0;
+    }
+
+    CHECK(cstr_batch_compare(w, strs, n, v, eq) == same);
+    for(size_t i = 0; i < n; i++)
+        CHECK(eq[i] == (lens[i] == 4 && memcmp(copy[i], with, 4) == 0));
+    CHECK(cstr_batch_compare(w, strs, n, v, NULL) == same);
+
+    CHECK(cstr_batch_view_compare(w, views, n, v, eq) == vsame);
+    for(size_t i = 0; i < n; i++)
+        CHECK(eq[i] == (views[i].len == 4 && memcmp(copy[i], with, 4) == 0));
+    CHECK(cstr_batch_view_compare(w, views, n, v, NULL) == vsame);
+
+    // finds, with and without out
+    cstr_pattern pat = cstr_pattern_n(needle, 2);
+    size_t hits = 0, vhits = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        hits += naive_find(copy[i], lens[i], needle, 2) != npos;
+        vhits += naive_find(copy[i], views[i].len, needle, 2) != npos;
+    }
+
+    CHECK(cstr_batch_find(w, strs, n, pat, pos) == hits);
+    for(size_t i = 0; i < n; i++)
+        CHECK(pos[i] == naive_find(copy[i], lens[i], needle, 2));
+    CHECK(cstr_batch_find(w, strs, n, pat, NULL) == hits);
+
+    CHECK(cstr_batch_view_find(w, views, n, pat, pos) == vhits);
+    for(size_t i = 0; i < n; i++)
+        CHECK(pos[i] == naive_find(copy[i], views[i].len, needle, 2));
+    CHECK(cstr_batch_view_find(w, views, n, pat, NULL) == vhits);
+    cstr_pattern_delete(pat);
+
+    // folding, hashed first so that a cached hash left stale shows up
+    cstr_batch_hash(w, strs, n, hash);
+    cstr_batch_fold(w, strs, n);
+    for(size_t i = 0; i < n; i++)
+    {
+        if(strs[i] == NULL)
+            continue;
+
+        for(size_t k = 0; k < lens[i]; k++)
+            if(copy[i][k] >= 'A' && copy[i][k] <= 'Z')
+                copy[i][k] += 'a' - 'A';
+
+        CHECK(cstr_length(strs[i]) == lens[i]);
+        CHECK(memcmp(cstr_data(strs[i]), copy[i], lens[i]) == 0);
+        CHECK(cstr_hash(strs[i]) == fresh(copy[i], lens[i]));
+    }
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if(strs[i] != NULL)
+            delete_string(strs[i]);
+        free(copy[i]);
+    }
+
+    free(strs);
+    free(views);
+    free(copy);
+    free(lens);
+    free(pos);
+    free(hash);
+    free(eq);
+}
+
+int main(void)
+{
+    cstr_workers w = cstr_workers_new(4, 0);
+
+    for(int i = 0; i < 200; i++)
+        check_all(i % 2 ? w : NULL, rnd() % 300);
+
+    // enough strings to be split over the pool, with an uneven last chunk
+    check_all(w, 3 * 4096 + 123);
+    check_all(NULL, 3 * 4096 + 123);
+
+    cstr_workers_delete(w);
+    return done();
+}
@@ -0,0 +1,89 @@
+// The length-aware variants against a plain byte buffer, on contents full of
+// null characters, and shrink_to_fit keeping them
+//
+//   cc -std=gnu11 -I.. binary.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static char model[1 << 14];
+static size_t size;
+
+// like find_n, an empty needle is never found
+static size_t naive_find(const char * needle, size_t len)
+{
+    if(len == 0)
+        return npos;
+    for(size_t i = 0; i + len <= size; i++)
+        if(memcmp(model + i, needle, len) == 0)
+            return i;
+    return npos;
+}
+
+int main(void)
+{
+    cstring * s = string_n("", 0);
+
+    for(int i = 0; i < 100000; i++)
+    {
+        char buf[40];
+        size_t len = rnd() % sizeof(buf), pos = rnd() % (size + 2);
+        for(size_t k = 0; k < len; k++)
+            buf[k] = rnd() % 3 ? '\0' : 'a' + rnd() % 2;
+
+        switch(rnd() % (size > 8000 ? 2 : 5))
+        {
+        case 0:
+            memcpy(model, buf, len);
+            size = len;
+            cstr_assign_n(s, buf, len);
+            break;
+        case 1:
+        {
+            // needles taken from the string itself are found more often
+            const char * needle = size > len && rnd() % 2 ? model + rnd() % (size - len) : buf;
+            size_t next = 0, at = naive_find(needle, len);
+            CHECK(cstr_find_n(s, needle, len, &next) == at);
+            CHECK(cstr_compare_n(s, needle, len) == (len == size && memcmp(model, needle, len) == 0));
+            break;
+        }
+        case 2:
+            if(pos <= size)
+            {
+                memmove(model + pos + len, model + pos, size - pos);
+                memcpy(model + pos, buf, len);
+                size += len;
+            }
+            cstr_insert_n(s, pos, buf, len);
+            break;
+        default:
+            memcpy(model + size, buf, len);
+            size += len;
+            cstr_append_n(s, buf, len);
+            break;
+        }
+
+        CHECK(cstr_length(s) == size && memcmp(cstr_data(s), model, size) == 0);
+        CHECK(cstr_compare_n(s, model, size));
+    }
+    delete_string(s);
+
+    // shrink_to_fit releases capacity and keeps every character
+    for(size_t len = 0; len < 300; len += 7)
+    {
+        char buf[300] = "text";
+        s = string_n(buf, len);
+        cstr_reserve(s, 1000);
+        cstr_shrink_to_fit(s);
+        CHECK(cstr_length(s) == len && memcmp(cstr_data(s), buf, len) == 0);
+        CHECK(cstr_capacity(s) == (len <= 23 ? 23 : len));
+
+        cstr_resize(s, len + 50);
+        uint64_t h = cstr_hash(s);
+        cstr_shrink_to_fit(s);
+        CHECK(cstr_length(s) == len + 50 && cstr_data(s)[len + 49] == '\0' && cstr_hash(s) == h);
+        delete_string(s);
+    }
+
+    return done();
+}
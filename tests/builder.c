@@ -0,0 +1,89 @@
+// Builders fed random fragments and formats against the same output written
+// with snprintf into one plain buffer
+//
+//   cc -std=gnu11 -I.. builder.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define MAX (1 << 16)
+
+static char model[MAX];
+static size_t size;
+
+int main(void)
+{
+    char word[600];
+
+    for(int i = 0; i < 2000; i++)
+    {
+        cstr_arena arena = i % 4 ? NULL : cstr_arena_new(0);
+        cstring_builder b = arena ? cstr_builder_alloc(rnd() % 50, cstr_arena_allocator(arena))
+                                  : cstr_builder_new(rnd() % 50);
+        size = 0;
+
+        for(int step = 0; step < 40 && size < MAX - 4000; step++)
+        {
+            size_t len = rnd() % (step % 8 ? 16 : sizeof(word) - 1);
+            for(size_t k = 0; k < len; k++)
+                word[k] = 'a' + rnd() % 26;
+            word[len] = '\0';
+
+            switch(rnd() % 7)
+            {
+            case 0:
+                cstr_builder_append(b, word);
+                break;
+            case 1:
+                cstr_builder_append_n(b, word, len);
+                break;
+            case 2:
+                cstr_builder_append_view(b, cstr_view_n(word, len));
+                break;
+            case 3:
+            {
+                cstr_view parts[3] = { cstr_view_n(word, len), cstr_view_n("|", 1), cstr_view_n(word, len / 2) };
+                cstr_builder_append_all(b, parts, 3);
+                size += snprintf(model + size, MAX - size, "%s|%.*s", word, (int)(len / 2), word);
+                continue;
+            }
+            case 4:
+                cstr_builder_concat(b, "<", word, ">", "", word, NULL);
+                size += snprintf(model + size, MAX - size, "<%s>%s", word, word);
+                continue;
+            case 5:
+            {
+                int n = rnd(), w = rnd() % 40;
+                double d = (int)rnd() / 1000.0;
+                cstr_builder_appendf(b, "%d %x %.3f %-*s|%c", n, n, d, w, word, 'A' + n % 26);
+                size += snprintf(model + size, MAX - size, "%d %x %.3f %-*s|%c", n, n, d, w, word, 'A' + n % 26);
+                continue;
+            }
+            default:
+                cstr_builder_reserve(b, size + rnd() % 1000);
+                continue;
+            }
+
+            memcpy(model + size, word, len);
+            size += len;
+        }
+
+        CHECK(cstr_builder_ok(b) && cstr_builder_length(b) == size);
+        CHECK(memcmp(cstr_builder_data(b), model, size) == 0);
+
+        if(i % 2)
+        {
+            cstring * s = cstr_builder_finish(b);
+            CHECK(s != NULL && cstr_length(s) == size && memcmp(cstr_data(s), model, size) == 0);
+            CHECK(cstr_data(s)[size] == '\0');
+            delete_string(s);
+        }
+        else
+            cstr_builder_delete(b);
+
+        if(arena)
+            cstr_arena_delete(arena);
+    }
+
+    return done();
+}
@@ -0,0 +1,73 @@
+// The find_first_of family and its precompiled set versions against naive
+// loops over every byte value, with haystacks long enough for each vector
+// width. Built twice, once with CSTR_NO_SIMD for the portable version
+//
+//   cc -std=gnu11 -I.. charset.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static bool naive_has(const char * chars, size_t len, char c)
+{
+    return memchr(chars, c, len) != NULL;
+}
+
+// the members search [pos, n), forwards or backwards
+static size_t naive_span(const char * h, size_t n, const char * chars, size_t len, size_t pos, bool in, bool reverse)
+{
+    if(pos >= n)
+        return npos;
+    for(size_t k = 0; k < n - pos; k++)
+    {
+        size_t i = reverse ? n - 1 - k : pos + k;
+        if(naive_has(chars, len, h[i]) == in)
+            return i;
+    }
+    return npos;
+}
+
+int main(void)
+{
+    static char hay[1000];
+
+    for(int i = 0; i < 20000; i++)
+    {
+        // small alphabets over all of 0-255 so both members and non members run long
+        unsigned char base = rnd(), spread = 1 + rnd() % 6;
+        size_t n = rnd() % (i % 4 ? 100 : sizeof(hay));
+        for(size_t k = 0; k < n; k++)
+            hay[k] = base + rnd() % spread;
+
+        char chars[12];
+        size_t len = 1 + rnd() % (sizeof(chars) - 1);
+        for(size_t k = 0; k < len; k++)
+            chars[k] = base + rnd() % (spread + 2);
+        chars[len] = '\0';
+
+        cstring * s = string_n(hay, n);
+        cstr_charset set = cstr_charset_n(chars, len);
+        size_t pos = rnd() % 3 ? rnd() % (n + 1) : 0;
+
+        for(int c = 0; c < 256; c += 17)
+            CHECK(cstr_charset_has(&set, c) == naive_has(chars, len, c));
+
+        CHECK(cstr_find_first_in(s, &set, pos)     == naive_span(hay, n, chars, len, pos, true, false));
+        CHECK(cstr_find_last_in(s, &set, pos)      == naive_span(hay, n, chars, len, pos, true, true));
+        CHECK(cstr_find_first_not_in(s, &set, pos) == naive_span(hay, n, chars, len, pos, false, false));
+        CHECK(cstr_find_last_not_in(s, &set, pos)  == naive_span(hay, n, chars, len, pos, false, true));
+
+        // the string versions stop at a null character in the set
+        size_t slen = strlen(chars);
+        if(slen > 0)
+        {
+            CHECK(cstr_find_first_of(s, chars, pos)     == naive_span(hay, n, chars, slen, pos, true, false));
+            CHECK(cstr_find_last_of(s, chars, pos)      == naive_span(hay, n, chars, slen, pos, true, true));
+            CHECK(cstr_find_first_not_of(s, chars, pos) == naive_span(hay, n, chars, slen, pos, false, false));
+            CHECK(cstr_find_last_not_of(s, chars, pos)  == naive_span(hay, n, chars, slen, pos, false, true));
+        }
+
+        delete_string(s);
+    }
+
+    return done();
+}
@@ -0,0 +1,34 @@
+// Shared helpers for the tests, each test compares the library against a
+// naive reference and exits with the number of failed checks
+
+#ifndef CSTR_CHECK_H
+#define CSTR_CHECK_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static atomic_int failures;
+
+#define CHECK(cond) do { if(!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+                                       atomic_fetch_add(&failures, 1); } } while(0)
+
+// xorshift, so every run sees the same inputs
+static unsigned long long seed = 88172645463325252ULL;
+
+static inline unsigned rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (unsigned)seed;
+}
+
+static inline int done(void)
+{
+    printf(failures ? "FAILED\n" : "ok\n");
+    return failures != 0;
+}
+
+#endif
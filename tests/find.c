@@ -0,0 +1,73 @@
+// Substring search against a naive scan, with needles and haystacks of every
+// length around the vector widths so that each lane, tail and dispatch path
+// sees matches. Built twice, once with CSTR_NO_SIMD for the portable version
+//
+//   cc -std=gnu11 -I.. find.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static size_t naive_find(const char * h, size_t n, const char * needle, size_t len, size_t pos)
+{
+    if(len == 0 || n == 0)
+        return npos;
+    for(size_t i = pos; i + len <= n; i++)
+        if(memcmp(h + i, needle, len) == 0)
+            return i;
+    return npos;
+}
+
+int main(void)
+{
+    static char hay[4096];
+
+    for(int i = 0; i < 30000; i++)
+    {
+        size_t n = i % 4 ? rnd() % 200 : rnd() % sizeof(hay);
+        int alpha = 1 + rnd() % 4;
+        for(size_t k = 0; k < n; k++)
+            hay[k] = 'a' + rnd() % alpha;
+
+        char needle[80];
+        size_t len = 1 + rnd() % (i % 3 ? 8 : 70);
+        if(n >= len && rnd() % 2)
+            memcpy(needle, hay + rnd() % (n - len + 1), len);
+        else
+            for(size_t k = 0; k < len; k++)
+                needle[k] = 'a' + rnd() % alpha;
+
+        cstring * s = string_n(hay, n);
+
+        // every occurrence in turn through nxt_pos, the way callers loop
+        size_t next = rnd() % 4 ? 0 : rnd() % (n + 2), pos = next;
+        for(int k = 0; k < 64; k++)
+        {
+            size_t want = naive_find(hay, n, needle, len, pos);
+            size_t got = cstr_find_n(s, needle, len, &next);
+            CHECK(got == want);
+            if(got != want || got == npos)
+                break;
+            CHECK(next == got + len);
+            pos = next;
+        }
+
+        cstr_view v = cstr_view_n(hay, n);
+        size_t from = rnd() % (n + 1);
+        CHECK(cstr_view_find(v, cstr_view_n(needle, len), from) == naive_find(hay, n, needle, len, from));
+
+        delete_string(s);
+    }
+
+    // a match ending exactly at the last byte of a long haystack
+    memset(hay, 'x', sizeof(hay));
+    for(size_t len = 1; len < 70; len++)
+    {
+        memset(hay + sizeof(hay) - len, 'y', len);
+        cstring * s = string_n(hay, sizeof(hay));
+        CHECK(cstr_find_n(s, hay + sizeof(hay) - len, len, NULL) == sizeof(hay) - len);
+        delete_string(s);
+        memset(hay + sizeof(hay) - len, 'x', len);
+    }
+
+    return done();
+}
@@ -0,0 +1,108 @@
+// Random appends, inserts, erases and assigns against a plain char buffer,
+// and the number of reallocations it takes to build a long string one
+// character at a time
+//
+//   cc -std=gnu11 -I.. growth.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define ROUNDS 200000
+
+static char model[1 << 16];
+static size_t size;
+
+int main(void)
+{
+    cstring * s = string("");
+
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        char buf[64];
+        size_t len = rnd() % sizeof(buf), pos = rnd() % (size + 2);
+        for(size_t k = 0; k < len; k++)
+            buf[k] = 'a' + rnd() % 26;
+
+        switch(rnd() % (size > 30000 ? 4 : 7))
+        {
+        case 0:
+            if(pos <= size && len <= size)
+            {
+                size_t n = len > size - pos ? size - pos : len;
+                memmove(model + pos, model + pos + n, size - pos - n);
+                size -= n;
+            }
+            cstr_erase(s, pos, len);
+            break;
+        case 1:
+            if(size > 0)
+                size--;
+            cstr_pop_back(s);
+            break;
+        case 2:
+            memcpy(model, buf, len);
+            size = len;
+            cstr_assign_n(s, buf, len);
+            break;
+        case 3:
+            model[size++] = buf[0];
+            cstr_push_back(s, buf[0]);
+            break;
+        case 4:
+        case 5:
+            memcpy(model + size, buf, len);
+            size += len;
+            cstr_append_n(s, buf, len);
+            break;
+        default:
+            if(pos <= size)
+            {
+                memmove(model + pos + len, model + pos, size - pos);
+                memcpy(model + pos, buf, len);
+                size += len;
+            }
+            cstr_insert_n(s, pos, buf, len);
+            break;
+        }
+
+        CHECK(cstr_length(s) == size && memcmp(cstr_data(s), model, size) == 0);
+        CHECK(cstr_data(s)[size] == '\0' && cstr_capacity(s) >= size);
+    }
+    delete_string(s);
+
+    // a million push_backs move the buffer a logarithmic number of times
+    s = string("");
+    const char * last = cstr_data(s);
+    int moves = 0;
+    for(int i = 0; i < 1000000; i++)
+    {
+        cstr_push_back(s, 'a' + i % 26);
+        if(cstr_data(s) != last)
+            moves++;
+        last = cstr_data(s);
+    }
+    CHECK(moves <= 40);
+    for(int i = 0; i < 1000000; i++)
+        CHECK(cstr_at(s, i) == 'a' + i % 26);
+
+    // shrinking keeps the buffer and its capacity
+    size_t cap = cstr_capacity(s);
+    cstr_erase(s, 10, 500000);
+    cstr_pop_back(s);
+    CHECK(cstr_data(s) == last && cstr_capacity(s) == cap && cstr_length(s) == 499999);
+    delete_string(s);
+
+    // reserve pre-sizes exactly and later appends up to it stay in place
+    s = string("x");
+    cstr_reserve(s, 5000);
+    CHECK(cstr_capacity(s) == 5000);
+    last = cstr_data(s);
+    for(int i = 1; i < 5000; i++)
+        cstr_push_back(s, 'x');
+    CHECK(cstr_data(s) == last && cstr_length(s) == 5000);
+    cstr_reserve(s, 10);
+    CHECK(cstr_capacity(s) == 5000);
+    delete_string(s);
+
+    return done();
+}
@@ -0,0 +1,69 @@
+// The cached hash after every kind of modification against hashing the same
+// characters from scratch, so a modifier that forgets to reset it shows up
+//
+//   cc -std=gnu11 -I.. hash.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static uint64_t fresh(cstring * s)
+{
+    cstring * t = string_n(cstr_data(s), cstr_length(s));
+    uint64_t h = cstr_hash(t);
+    delete_string(t);
+    return h;
+}
+
+int main(void)
+{
+    cstring * s = string("");
+    cstring * other = string("some other string that lives on the heap");
+
+    for(int i = 0; i < 100000; i++)
+    {
+        char buf[40];
+        size_t len = rnd() % sizeof(buf), pos = rnd() % (cstr_length(s) + 1);
+        for(size_t k = 0; k < len; k++)
+            buf[k] = 'a' + rnd() % 26;
+
+        // hash first so that there is a cached value to go stale
+        cstr_hash(s);
+
+        switch(cstr_length(s) > 2000 ? 3 + rnd() % 2 : rnd() % 17)
+        {
+        case 0:  cstr_append_n(s, buf, len); break;
+        case 1:  cstr_push_back(s, buf[0]); break;
+        case 2:  cstr_insert_n(s, pos, buf, len); break;
+        case 3:  cstr_erase(s, pos, len); break;
+        case 4:  cstr_pop_back(s); break;
+        case 5:  cstr_assign_n(s, buf, len); break;
+        case 6:  cstr_append_int(s, (int)rnd()); break;
+        case 7:  cstr_append_double(s, rnd() / 7.0); break;
+        case 8:  cstr_resize(s, pos + len); break;
+        case 9:  cstr_shrink_to_fit(s); break;
+        case 10: cstr_append_view(s, cstr_subview(s, pos, len)); break;
+        case 11: cstr_insert_view(s, pos, cstr_view_n(buf, len)); break;
+        case 12: if(rnd() % 8 == 0) cstr_clear(s); break;
+        case 13: cstr_hash(other); cstr_swap(s, other); break;
+        case 14: cstr_share(s, other); break;
+        case 15: cstr_append(other, "x"); cstr_hash(other); break;
+        default: cstr_assign_view(s, cstr_subview(s, pos, len)); break;
+        }
+
+        CHECK(cstr_hash(s) == fresh(s));
+        CHECK(cstr_hash(s) == cstr_view_hash(cstr_view_of(s)));
+        CHECK(cstr_hash(other) == fresh(other));
+    }
+
+    // equal contents hash equal whichever way they were built
+    cstring * a = string("hello, world");
+    cstring * b = string("hello");
+    cstr_append(b, ", world");
+    CHECK(cstr_hash(a) == cstr_hash(b) && cstr_hash(a) != cstr_hash(s));
+
+    delete_string(a);
+    delete_string(b);
+    delete_string(s);
+    delete_string(other);
+    return done();
+}
@@ -0,0 +1,69 @@
+// Insert, erase and pop_back within the reserved capacity never move the
+// buffer, and give the same results as memmove on a plain copy, including
+// when the inserted characters come from the string itself
+//
+//   cc -std=gnu11 -I.. in_place.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define CAP 4096
+
+int main(void)
+{
+    static char model[CAP], src[CAP];
+    size_t size = 0;
+
+    cstring * s = string("");
+    cstr_reserve(s, CAP);
+    const char * buf = cstr_data(s);
+
+    for(int i = 0; i < 200000; i++)
+    {
+        size_t pos = rnd() % (size + 1), len = rnd() % 64;
+
+        if(size + len < CAP && rnd() % 2)
+        {
+            // half the inserts copy a piece of the string into itself,
+            // from before, across or after pos
+            bool self = size > 0 && rnd() % 2;
+            size_t from = self ? rnd() % size : 0;
+            if(self && len > size - from)
+                len = size - from;
+
+            const char * p = self ? cstr_data(s) + from : src;
+            if(!self)
+                for(size_t k = 0; k < len; k++)
+                    src[k] = 'a' + rnd() % 26;
+
+            char piece[64];
+            memcpy(piece, self ? model + from : src, len);
+            memmove(model + pos + len, model + pos, size - pos);
+            memcpy(model + pos, piece, len);
+            size += len;
+            cstr_insert_n(s, pos, p, len);
+        }
+        else if(rnd() % 4)
+        {
+            if(pos < size && len <= size)
+            {
+                size_t n = len > size - pos ? size - pos : len;
+                memmove(model + pos, model + pos + n, size - pos - n);
+                size -= n;
+            }
+            cstr_erase(s, pos, len);
+        }
+        else
+        {
+            if(size > 0)
+                size--;
+            cstr_pop_back(s);
+        }
+
+        CHECK(cstr_data(s) == buf && cstr_capacity(s) == CAP);
+        CHECK(cstr_length(s) == size && memcmp(cstr_data(s), model, size) == 0 && buf[size] == '\0');
+    }
+
+    delete_string(s);
+    return done();
+}
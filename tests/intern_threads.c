@@ -0,0 +1,86 @@
+// Eight threads interning and looking up the same keys in one pool, every
+// thread must get the same canonical string for the same contents. Meant to
+// be run under ThreadSanitizer as well
+//
+//   cc -std=gnu11 -fsanitize=thread -I.. intern_threads.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define THREADS 8
+#define KEYS    5000
+#define ROUNDS  50000
+
+static cstr_pool pool;
+static cstring * seen[THREADS][KEYS];
+static atomic_int failures;
+
+static void * work(void * arg)
+{
+    long id = (long)arg;
+    unsigned long long r = id * 7919 + 1;
+
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        r ^= r << 13;
+        r ^= r >> 7;
+        r ^= r << 17;
+
+        char key[32];
+        int k = r % KEYS;
+        int len = sprintf(key, "key-%d", k);
+
+        // lookups run alongside the inserts of other threads
+        cstring * found = cstr_pool_lookup(pool, cstr_view_n(key, len));
+        cstring * s = cstr_intern_n(pool, key, len);
+
+        if(s == NULL || cstr_length(s) != (size_t)len || memcmp(cstr_data(s), key, len) != 0
+           || (found != NULL && found != s) || (seen[id][k] != NULL && seen[id][k] != s))
+            atomic_fetch_add(&failures, 1);
+        seen[id][k] = s;
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    pool = cstr_pool_new();
+
+    pthread_t t[THREADS];
+    for(long i = 0; i < THREADS; i++)
+        pthread_create(&t[i], NULL, &work, (void *)i);
+    for(int i = 0; i < THREADS; i++)
+        pthread_join(t[i], NULL);
+
+    // every thread holds the same string for a key, and the pool holds
+    // exactly the keys that some thread interned
+    size_t distinct = 0;
+    for(int k = 0; k < KEYS; k++)
+    {
+        cstring * canon = NULL;
+        for(int i = 0; i < THREADS; i++)
+        {
+            if(seen[i][k] == NULL)
+                continue;
+            if(canon != NULL && canon != seen[i][k])
+                atomic_fetch_add(&failures, 1);
+            canon = seen[i][k];
+        }
+
+        char key[32];
+        int len = sprintf(key, "key-%d", k);
+        if(cstr_pool_lookup(pool, cstr_view_n(key, len)) != canon)
+            atomic_fetch_add(&failures, 1);
+        distinct += canon != NULL;
+    }
+
+    if(cstr_pool_size(pool) != distinct)
+        atomic_fetch_add(&failures, 1);
+
+    cstr_pool_delete(pool);
+    printf(failures ? "FAILED\n" : "ok\n");
+    return failures != 0;
+}
@@ -0,0 +1,73 @@
+// Value iterators and the allocated cstr_iterator walking random strings in
+// both directions against indexing a plain copy, and writes through them
+//
+//   cc -std=gnu11 -I.. iterators.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+#include <ctype.h>
+
+int main(void)
+{
+    char model[200];
+
+    for(int i = 0; i < 5000; i++)
+    {
+        size_t n = rnd() % sizeof(model);
+        for(size_t k = 0; k < n; k++)
+            model[k] = 'a' + rnd() % 26;
+        cstring * s = string_n(model, n);
+
+        // forwards, begin to end
+        size_t k = 0;
+        for(cstr_it it = cstr_itr_begin(s); !cstr_it_equal(it, cstr_itr_end(s)); cstr_it_inc(&it))
+        {
+            CHECK(k < n && cstr_it_val(it) == model[k]);
+            k++;
+        }
+        CHECK(k == n);
+
+        // backwards, rbegin to rend, writing as it goes
+        k = n;
+        for(cstr_it it = cstr_itr_rbegin(s); !cstr_it_equal(it, cstr_itr_rend(s)); cstr_it_inc(&it))
+        {
+            CHECK(k > 0 && cstr_it_val(it) == model[k - 1]);
+            *cstr_it_ref(it) = toupper(model[--k]);
+        }
+        CHECK(k == 0);
+        for(k = 0; k < n; k++)
+            model[k] = toupper(model[k]);
+        CHECK(memcmp(cstr_data(s), model, n) == 0);
+
+        // dec undoes inc from either end
+        cstr_it e = cstr_itr_end(s), r = cstr_itr_rend(s);
+        for(k = n; k > 0; k--)
+        {
+            cstr_it_dec(&e);
+            cstr_it_dec(&r);
+            CHECK(cstr_it_val(e) == model[k - 1] && cstr_it_val(r) == model[n - k]);
+        }
+        CHECK(cstr_it_equal(e, cstr_itr_begin(s)) && cstr_it_equal(r, cstr_itr_rbegin(s)));
+
+        // the allocated iterators see the same characters
+        if(n > 0)
+        {
+            cstr_iterator f = cstr_begin(s), b = cstr_rbegin(s);
+            for(k = 0; k < n; k++)
+            {
+                CHECK(*f->val(f) == model[k] && *b->val(b) == model[n - 1 - k]);
+                if(k + 1 < n)
+                {
+                    f->inc(f);
+                    b->inc(b);
+                }
+            }
+            delete_itr(f);
+            delete_itr(b);
+        }
+
+        delete_string(s);
+    }
+
+    return done();
+}
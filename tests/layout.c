@@ -0,0 +1,89 @@
+// Every heap string is one block holding both the header and the characters,
+// checked by an allocator that tracks each live block, with the contents
+// compared against the source they were built from
+//
+//   cc -std=gnu11 -I.. layout.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define BLOCKS 64
+
+static struct { char * ptr; size_t size; } live[BLOCKS];
+static int count;
+
+static void * track_alloc(void * ctx, size_t size)
+{
+    (void)ctx;
+    char * p = malloc(size);
+    if(p != NULL && count < BLOCKS)
+    {
+        live[count].ptr = p;
+        live[count++].size = size;
+    }
+    return p;
+}
+
+static void track_free(void * ctx, void * ptr, size_t size)
+{
+    (void)ctx;
+    for(int i = 0; i < count; i++)
+        if(live[i].ptr == ptr)
+        {
+            CHECK(live[i].size == size);
+            live[i] = live[--count];
+            break;
+        }
+    free(ptr);
+}
+
+static void * track_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    void * p = track_alloc(ctx, new_size);
+    if(p == NULL)
+        return NULL;
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    track_free(ctx, ptr, old_size);
+    return p;
+}
+
+static const cstr_allocator tracked = { &track_alloc, &track_realloc, &track_free, NULL };
+
+// the block holding ptr[0..len], or -1
+static int block_of(const char * ptr, size_t len)
+{
+    for(int i = 0; i < count; i++)
+        if(ptr >= live[i].ptr && ptr + len < live[i].ptr + live[i].size)
+            return i;
+    return -1;
+}
+
+int main(void)
+{
+    char src[5000];
+    for(size_t k = 0; k < sizeof(src); k++)
+        src[k] = 1 + rnd() % 255;
+
+    for(size_t len = 24; len < sizeof(src); len += 1 + len / 8)
+    {
+        cstring * s = string_alloc(src, len, &tracked);
+
+        // the cstring and a single block for the string, which holds the
+        // characters and their terminator
+        CHECK(count == 2);
+        int b = block_of(cstr_data(s), len);
+        CHECK(b >= 0 && live[b].ptr != (char *)s);
+        CHECK(b >= 0 && cstr_data(s) - live[b].ptr <= 64);
+        CHECK(cstr_length(s) == len && memcmp(cstr_data(s), src, len) == 0 && cstr_data(s)[len] == '\0');
+
+        // growing moves the block, it never splits it
+        cstr_append_n(s, src, len);
+        CHECK(count == 2 && block_of(cstr_data(s), 2 * len) >= 0);
+        CHECK(memcmp(cstr_data(s), src, len) == 0 && memcmp(cstr_data(s) + len, src, len) == 0);
+
+        delete_string(s);
+        CHECK(count == 0);
+    }
+
+    return done();
+}
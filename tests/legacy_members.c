@@ -0,0 +1,72 @@
+// Callers of the older str->find(str, ...) style build unchanged with
+// CSTR_LEGACY_MEMBERS and get the same answers as the direct functions and
+// a naive search, from a library built without it
+//
+//   cc -std=gnu11 -I.. legacy_members.c ../cstring.c -lm -pthread && ./a.out
+
+#include "check.h"
+
+#define CSTR_LEGACY_MEMBERS
+#include "cstring.h"
+
+static size_t naive_find(const char * h, const char * needle)
+{
+    const char * p = strstr(h, needle);
+    return p == NULL ? npos : (size_t)(p - h);
+}
+
+int main(void)
+{
+    char buf[200];
+
+    for(int i = 0; i < 2000; i++)
+    {
+        size_t n = rnd() % sizeof(buf);
+        for(size_t k = 0; k < n; k++)
+            buf[k] = 'a' + rnd() % 4;
+        buf[n] = '\0';
+
+        cstring * str = string(buf);
+        CHECK(str->length(str) == n && str->data(str) == cstr_data(str));
+        CHECK(str->compare(str, buf) && str->empty(str) == (n == 0));
+
+        char needle[4] = { 'a' + rnd() % 4, 'a' + rnd() % 4, 'a' + rnd() % 4, '\0' };
+        CHECK(str->find(str, needle, NULL) == naive_find(buf, needle));
+        CHECK(str->find_first_of(str, needle, 0) == cstr_find_first_of(str, needle, 0));
+        CHECK(str->find_last_not_of(str, needle, n) == cstr_find_last_not_of(str, needle, n));
+        CHECK(n == 0 || (str->front(str) == buf[0] && str->back(str) == buf[n - 1] && str->at(str, n / 2) == buf[n / 2]));
+
+        str->append(str, needle);
+        str->push_back(str, 'z');
+        str->insert(str, 0, "<");
+        CHECK(str->length(str) == n + 5 && str->at(str, 0) == '<' && str->back(str) == 'z');
+        CHECK(memcmp(str->data(str) + 1, buf, n) == 0 && memcmp(str->data(str) + 1 + n, needle, 3) == 0);
+
+        str->erase(str, 0, 1);
+        str->pop_back(str);
+        str->resize(str, n + 10);
+        CHECK(str->length(str) == n + 10 && str->data(str)[n + 9] == '\0');
+        str->shrink_to_fit(str);
+        CHECK(str->length(str) == cstr_length(str) && memcmp(str->data(str), buf, n) == 0);
+
+        size_t len = str->length(str);
+        cstring * other = string("other");
+        str->swap(str, other);
+        CHECK(other->length(other) == len && str->compare(str, "other"));
+
+        str->assign(str, buf);
+        CHECK(str->compare(str, buf));
+
+        cstr_iterator it = str->begin(str);
+        CHECK(n == 0 || *it->val(it) == buf[0]);
+        delete_itr(it);
+
+        str->clear(str);
+        CHECK(str->empty(str) && str->max_size(str) == cstr_max_size(str));
+
+        delete_string(str);
+        delete_string(other);
+    }
+
+    return done();
+}
@@ -0,0 +1,74 @@
+// Mapped files of sizes around the page size against the same bytes read
+// with fread, before and after the string is modified, and the file itself
+// left untouched by those modifications
+//
+//   cc -std=gnu11 -I.. map.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+#include <unistd.h>
+
+static char path[] = "/tmp/cstr_mapXXXXXX";
+
+static size_t read_back(char * buf, size_t max)
+{
+    FILE * f = fopen(path, "rb");
+    size_t n = f == NULL ? 0 : fread(buf, 1, max, f);
+    if(f != NULL)
+        fclose(f);
+    return n;
+}
+
+int main(void)
+{
+    static char model[200000], back[200000];
+    size_t sizes[] = { 0, 10, 23, 24, 100, 4095, 4096, 4097, 8192, 65536 + 7, 150000 };
+
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        size_t n = sizes[i];
+        for(size_t k = 0; k < n; k++)
+            model[k] = rnd() % 8 ? 'a' + rnd() % 4 : '\0';
+
+        FILE * f = fopen(path, "wb");
+        fwrite(model, 1, n, f);
+        fclose(f);
+
+        cstring * s = string_map(path);
+        CHECK(s != NULL && cstr_length(s) == n && memcmp(cstr_data(s), model, n) == 0);
+        CHECK(cstr_data(s)[n] == '\0');
+        CHECK(cstr_hash(s) == cstr_view_hash(cstr_view_n(model, n)));
+
+        // searches read the mapping in place
+        char needle[3] = { 'a', 'b', 'c' };
+        const char * hit = NULL;
+        for(size_t k = 0; k + 3 <= n && hit == NULL; k++)
+            if(memcmp(model + k, needle, 3) == 0)
+                hit = model + k;
+        CHECK(cstr_find_n(s, needle, 3, NULL) == (hit == NULL ? npos : (size_t)(hit - model)));
+
+        // a share of the mapping and the mapping itself are each copied out
+        // when modified, and the file stays as it was
+        cstring * t = string_share(s);
+        cstr_append_n(t, "tail", 4);
+        CHECK(cstr_length(t) == n + 4 && memcmp(cstr_data(t), model, n) == 0);
+        CHECK(cstr_length(s) == n && memcmp(cstr_data(s), model, n) == 0);
+
+        cstr_erase(s, 0, n / 2);
+        cstr_push_back(s, 'z');
+        CHECK(cstr_length(s) == n - n / 2 + 1 && memcmp(cstr_data(s), model + n / 2, n - n / 2) == 0);
+        CHECK(read_back(back, sizeof(back)) == n && memcmp(back, model, n) == 0);
+
+        delete_string(s);
+        delete_string(t);
+    }
+
+    unlink(path);
+    CHECK(string_map(path) == NULL && string_map(NULL) == NULL);
+
+    return done();
+}
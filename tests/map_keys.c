@@ -0,0 +1,90 @@
+// The string map under random puts, gets and removes against a plain array of
+// keys searched linearly, with keys that share long prefixes and include null
+// characters, through several rounds of growth and tombstones
+//
+//   cc -std=gnu11 -I.. map_keys.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define KEYS 3000
+
+static char keys[KEYS][24];
+static size_t lens[KEYS];
+static bool present[KEYS];
+static size_t vals[KEYS];
+
+int main(void)
+{
+    for(int k = 0; k < KEYS; k++)
+    {
+        // a common prefix, a null inside some keys and lengths either side of inline
+        lens[k] = (size_t)snprintf(keys[k], sizeof(keys[k]), "prefix-%d", k);
+        if(k % 7 == 0)
+            keys[k][6] = '\0';
+        if(k % 3 == 0)
+            lens[k] = (size_t)snprintf(keys[k] + lens[k], sizeof(keys[k]) - lens[k], "-long-tail") + lens[k];
+    }
+
+    cstr_map m = cstr_map_new(rnd() % 2 ? 0 : 16);
+    size_t size = 0;
+
+    for(int i = 0; i < 400000; i++)
+    {
+        // the live range moves so that removed slots are reused
+        int k = (i / 1000 + rnd() % 500) % KEYS;
+        cstr_view key = cstr_view_n(keys[k], lens[k]);
+        void * got = NULL;
+
+        switch(rnd() % 4)
+        {
+        case 0:
+        case 1:
+            CHECK(cstr_map_put(m, key, (void *)(size_t)i));
+            size += !present[k];
+            present[k] = true;
+            vals[k] = i;
+            break;
+        case 2:
+            CHECK(cstr_map_remove(m, key) == present[k]);
+            size -= present[k];
+            present[k] = false;
+            break;
+        default:
+            CHECK(cstr_map_get(m, key, &got) == present[k]);
+            CHECK(!present[k] || (size_t)got == vals[k]);
+            break;
+        }
+        CHECK(cstr_map_size(m) == size);
+    }
+
+    // iteration visits each present key once with its value
+    static bool visited[KEYS];
+    size_t pos = 0, count = 0;
+    cstring * key;
+    void * val;
+    while(cstr_map_next(m, &pos, &key, &val))
+    {
+        int k = 0;
+        while(k < KEYS && !(cstr_length(key) == lens[k] && memcmp(cstr_data(key), keys[k], lens[k]) == 0))
+            k++;
+        CHECK(k < KEYS && present[k] && !visited[k] && (size_t)val == vals[k]);
+        if(k < KEYS)
+            visited[k] = true;
+        count++;
+    }
+    CHECK(count == size);
+
+    // the cstring versions find the same entries
+    for(int k = 0; k < KEYS; k++)
+    {
+        cstring * s = string_n(keys[k], lens[k]);
+        CHECK(cstr_map_get_string(m, s, NULL) == present[k]);
+        CHECK(cstr_map_put_string(m, s, NULL) && cstr_map_get(m, cstr_view_of(s), &val) && val == NULL);
+        delete_string(s);
+    }
+    CHECK(cstr_map_size(m) == KEYS);
+
+    cstr_map_delete(m);
+    return done();
+}
@@ -0,0 +1,200 @@
+// Numeric append and parse against the C library: integers against printf
+// and strtoll, doubles against the shortest digits that printf can give and
+// that strtod reads back to the same value. Define ROUNDS to try more doubles
+//
+//   cc -std=gnu11 -I.. numeric.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+#include <errno.h>
+#include <math.h>
+
+#ifndef ROUNDS
+#define ROUNDS 50000
+#endif
+
+static uint64_t rnd64(void)
+{
+    return (uint64_t)rnd() << 32 | rnd();
+}
+
+// the significant digits of printed text, without sign, point, exponent or
+// the leading and trailing zeros
+static size_t significant(const char * s, char * digits)
+{
+    size_t n = 0;
+    for( ; *s && *s != 'e'; s++)
+        if(*s >= '0' && *s <= '9' && (n > 0 || *s != '0'))
+            digits[n++] = *s;
+    while(n > 0 && digits[n - 1] == '0')
+        n--;
+    digits[n] = '\0';
+    return n;
+}
+
+// the fewest significant digits that read back as d, trying printf's
+// nearest digits and their neighbours at each precision, and whether the
+// nearest digits are the ones that do so
+static size_t shortest(double d, char * nearest)
+{
+    char tmp[64];
+    for(int prec = 0; prec < 17; prec++)
+    {
+        snprintf(tmp, sizeof(tmp), "%.*e", prec, d);
+        if(strtod(tmp, NULL) == d)
+        {
+            significant(tmp, nearest);
+            return prec + 1;
+        }
+
+        // the decimals either side at the same precision
+        char digits[32];
+        size_t n = 0;
+        for(const char * p = tmp; *p != 'e'; p++)
+            if(*p >= '0' && *p <= '9')
+                digits[n++] = *p;
+        long long m = atoll((digits[n] = '\0', digits));
+        int e = atoi(strchr(tmp, 'e') + 1) - prec;
+        for(int step = -1; step <= 1; step += 2)
+        {
+            snprintf(tmp, sizeof(tmp), "%llde%d", m + step, e);
+            if(strtod(tmp, NULL) == d)
+            {
+                nearest[0] = '\0';
+                return prec + 1;
+            }
+        }
+    }
+    return 17;
+}
+
+static void check_double(double d)
+{
+    cstring * s = string("");
+    cstr_append_double(s, d);
+
+    char digits[32], nearest[32];
+    CHECK(strtod(cstr_data(s), NULL) == d);
+    size_t want = shortest(d, nearest);
+    size_t got = significant(cstr_data(s), digits);
+    CHECK(got == want);
+    CHECK(nearest[0] == '\0' || strcmp(digits, nearest) == 0);
+    if(got != want || (nearest[0] && strcmp(digits, nearest) != 0))
+        printf("  %.17g printed as %s\n", d, cstr_data(s));
+
+    // and back again
+    double back;
+    size_t end;
+    CHECK(cstr_to_double(s, 0, &back, &end) && back == d && end == cstr_length(s));
+    delete_string(s);
+}
+
+int main(void)
+{
+    char buf[64];
+
+    // integers, the extremes and every length
+    int64_t ints[] = { 0, 1, -1, 9, 10, -10, 99, 100, INT64_MAX, INT64_MIN, INT64_MAX - 1, INT64_MIN + 1 };
+    for(size_t i = 0; i < sizeof(ints) / sizeof(ints[0]) + 100000; i++)
+    {
+        int64_t v = i < sizeof(ints) / sizeof(ints[0]) ? ints[i] : (int64_t)(rnd64() >> rnd() % 64);
+        if(rnd() % 2)
+            v = (int64_t)(0 - (uint64_t)v);
+        uint64_t u = rnd64() >> rnd() % 64;
+
+        cstring * s = string("x");
+        cstr_append_int(s, v);
+        cstr_append_uint(s, u);
+        snprintf(buf, sizeof(buf), "x%lld%llu", (long long)v, (unsigned long long)u);
+        CHECK(cstr_compare(s, buf));
+        delete_string(s);
+    }
+
+    // parsing integers, with overflow and junk around them
+    for(int i = 0; i < 100000; i++)
+    {
+        char text[40];
+        size_t n = 0;
+        text[n++] = ' ';
+        if(rnd() % 3 == 0)
+            text[n++] = "+-"[rnd() % 2];
+        size_t digits = rnd() % 24;
+        for(size_t k = 0; k < digits; k++)
+            text[n++] = '0' + rnd() % 10;
+        if(rnd() % 2)
+            text[n++] = "x.e "[rnd() % 4];
+        text[n] = '\0';
+
+        cstring * s = string(text);
+        char * end;
+        int64_t v = 7;
+        size_t used = 0;
+        errno = 0;
+        long long want = strtoll(text, &end, 10);
+        bool ok = end != text && errno != ERANGE;
+        CHECK(cstr_to_int(s, 0, &v, &used) == ok);
+        CHECK(!ok || (v == want && used == (size_t)(end - text)));
+
+        if(strchr(text, '-') == NULL)
+        {
+            uint64_t u = 7;
+            errno = 0;
+            unsigned long long uwant = strtoull(text, &end, 10);
+            ok = end != text && errno != ERANGE;
+            CHECK(cstr_to_uint(s, 0, &u, &used) == ok);
+            CHECK(!ok || (u == uwant && used == (size_t)(end - text)));
+        }
+        delete_string(s);
+    }
+
+    // doubles: the reported cases, edges, every bit pattern and short decimals
+    check_double(150833.039408867);
+    check_double(379344.078817734);
+    check_double(5e-324);
+    check_double(2.2250738585072014e-308);
+    check_double(1.7976931348623157e308);
+    check_double(0.1);
+    check_double(1e21);
+    check_double(1e-7);
+    for(int e = -1074; e < 1024; e++)
+        check_double(ldexp(1.0, e));
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        uint64_t bits = rnd64();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if(isfinite(d))
+            check_double(d);
+
+        snprintf(buf, sizeof(buf), "%u.%ue%d", rnd() % 100000, rnd() % 1000, (int)(rnd() % 60) - 30);
+        check_double(strtod(buf, NULL));
+    }
+
+    // the layout, JavaScript's
+    const char * layout[][2] = { { "0.1", "0.1" }, { "1e21", "1e+21" }, { "1e20", "100000000000000000000" },
+                                 { "1e-7", "1e-7" }, { "1.5e-6", "0.0000015" }, { "-0", "-0" },
+                                 { "123.456", "123.456" }, { "1.25e-300", "1.25e-300" } };
+    for(size_t i = 0; i < sizeof(layout) / sizeof(layout[0]); i++)
+    {
+        cstring * s = string("");
+        cstr_append_double(s, strtod(layout[i][0], NULL));
+        CHECK(cstr_compare(s, layout[i][1]));
+        delete_string(s);
+    }
+
+    // parsing doubles, every correctly rounded result matches strtod
+    for(int i = 0; i < 200000; i++)
+    {
+        char text[80];
+        int n = snprintf(text, sizeof(text), "%s%.*f", rnd() % 2 ? "-" : "", (int)(rnd() % 25), (rnd64() >> rnd() % 64) / 1e6);
+        if(rnd() % 2)
+            snprintf(text + n, sizeof(text) - n, "e%d", (int)(rnd() % 700) - 350);
+
+        cstring * s = string(text);
+        double d, want = strtod(text, NULL);
+        CHECK(cstr_to_double(s, 0, &d, NULL) && (d == want || (d != d && want != want)));
+        delete_string(s);
+    }
+
+    return done();
+}
@@ -0,0 +1,81 @@
+// Parallel searches against their single threaded counterparts, with the
+// periodic input that makes chunks disagree on where their leftmost
+// occurrences start
+//
+//   cc -std=gnu11 -I.. par_find.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static void check(cstr_workers w, cstring * str, const char * needle, size_t len)
+{
+    size_t serial[4096], parallel[4096];
+    cstr_pattern pat = cstr_pattern_n(needle, len);
+
+    for(int overlap = 0; overlap < 2; overlap++)
+    {
+        size_t max = rnd() % 4096;
+        size_t a = cstr_find_all(str, pat, serial, max, overlap);
+        size_t b = cstr_par_find_all(w, str, pat, parallel, max, overlap);
+        size_t c = cstr_par_count(w, str, pat, overlap);
+
+        if(a != b || a != c || memcmp(serial, parallel, (a < max ? a : max) * sizeof(size_t)) != 0)
+        {
+            printf("find_all: %zu %zu %zu, needle of %zu, overlap %d\n", a, b, c, len, overlap);
+            atomic_fetch_add(&failures, 1);
+        }
+    }
+
+    size_t pos = rnd() % (cstr_length(str) + 2), next = pos;
+    size_t a = cstr_find_pattern(str, pat, &next);
+    size_t b = cstr_par_find(w, str, pat, pos);
+    if(a != b)
+    {
+        printf("find: %zu %zu from %zu\n", a, b, pos);
+        atomic_fetch_add(&failures, 1);
+    }
+
+    cstr_pattern_delete(pat);
+}
+
+int main(void)
+{
+    // runs of one character, the case a naive fixup walks again in full
+    char * run = malloc(1 << 16);
+    memset(run, 'a', 1 << 16);
+
+    cstring * str = string_n(run, 1 << 16);
+    cstr_workers w = cstr_workers_new(4, 1000);
+    for(size_t len = 1; len < 40; len++)
+        check(w, str, run, len);
+    check(w, str, run, 999);
+    check(w, str, run, 1001);
+    delete_string(str);
+    cstr_workers_delete(w);
+
+    // repeated records broken up by noise, small chunks so that many of them
+    // start inside an occurrence
+    for(int i = 0; i < 20000; i++)
+    {
+        char unit[8], buf[800], needle[80];
+        size_t ul = 1 + rnd() % 6, n = rnd() % 800, len = 1 + rnd() % (i % 3 ? 8 : 70);
+
+        for(size_t k = 0; k < ul; k++)
+            unit[k] = 'a' + rnd() % 2;
+        for(size_t k = 0; k < n; k++)
+            buf[k] = rnd() % 50 ? unit[k % ul] : 'a' + rnd() % 3;
+
+        size_t from = n > len ? rnd() % (n - len) : 0;
+        for(size_t k = 0; k < len; k++)
+            needle[k] = n > len && i % 4 ? buf[from + k] : unit[k % ul];
+
+        w = i % 9 ? cstr_workers_new(1 + rnd() % 4, 1 + rnd() % 60) : NULL;
+        str = string_n(buf, n);
+        check(w, str, needle, len);
+        delete_string(str);
+        cstr_workers_delete(w);
+    }
+
+    free(run);
+    return done();
+}
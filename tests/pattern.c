@@ -0,0 +1,94 @@
+// Precompiled needles against a naive scan, with needle lengths on both sides
+// of the switch from Horspool to Two-Way and periodic haystacks where the
+// overlapping and non-overlapping occurrences differ
+//
+//   cc -std=gnu11 -I.. pattern.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+// every occurrence from pos, the next search starting one past (overlap) or
+// just after the end of the previous occurrence
+static size_t naive_all(const char * h, size_t n, const char * needle, size_t len, bool overlap, size_t * out)
+{
+    size_t count = 0;
+    for(size_t i = 0; i + len <= n; )
+    {
+        if(memcmp(h + i, needle, len) == 0)
+        {
+            out[count++] = i;
+            i += overlap ? 1 : len;
+        }
+        else
+            i++;
+    }
+    return count;
+}
+
+int main(void)
+{
+    static char hay[3000];
+    static size_t want[3000], got[3000];
+
+    for(int i = 0; i < 20000; i++)
+    {
+        size_t n = rnd() % (i % 5 ? 300 : sizeof(hay));
+        size_t unit = 1 + rnd() % 5;
+        for(size_t k = 0; k < n; k++)
+            hay[k] = rnd() % 20 ? 'a' + (k % unit) % 2 : 'a' + rnd() % 3;
+
+        char needle[100];
+        size_t len = 1 + rnd() % (i % 2 ? 10 : 90);
+        if(n >= len && rnd() % 3)
+            memcpy(needle, hay + rnd() % (n - len + 1), len);
+        else
+            for(size_t k = 0; k < len; k++)
+                needle[k] = 'a' + (k % unit) % 2;
+
+        cstr_pattern pat = cstr_pattern_n(needle, len);
+        CHECK(pat != NULL && cstr_pattern_length(pat) == len);
+        cstr_view v = cstr_view_n(hay, n);
+        cstring * s = string_n(hay, n);
+
+        for(int overlap = 0; overlap < 2; overlap++)
+        {
+            size_t count = naive_all(hay, n, needle, len, overlap, want);
+
+            // the iterator
+            cstr_matches it = cstr_pattern_matches(pat, v, overlap);
+            size_t k = 0, pos;
+            while(cstr_matches_next(&it, &pos))
+            {
+                CHECK(k < count && pos == want[k]);
+                k++;
+            }
+            CHECK(k == count);
+
+            // find_all stores what fits and counts everything
+            size_t max = rnd() % (count + 2);
+            CHECK(cstr_find_all(s, pat, got, max, overlap) == count);
+            CHECK(memcmp(got, want, (max < count ? max : count) * sizeof(size_t)) == 0);
+
+            // find_pattern walking with nxt_pos gives the non-overlapping ones
+            if(!overlap)
+            {
+                size_t next = 0;
+                for(k = 0; k <= count; k++)
+                    CHECK(cstr_find_pattern(s, pat, &next) == (k < count ? want[k] : npos));
+            }
+        }
+
+        // any start position
+        size_t from = rnd() % (n + 2), first = npos;
+        for(size_t k = from; k + len <= n && first == npos; k++)
+            if(memcmp(hay + k, needle, len) == 0)
+                first = k;
+        CHECK(cstr_pattern_find(pat, v, from) == first);
+
+        delete_string(s);
+        cstr_pattern_delete(pat);
+    }
+
+    CHECK(cstr_pattern_n("", 0) == NULL && cstr_pattern_new("") == NULL);
+    return done();
+}
@@ -0,0 +1,97 @@
+// A rope edited at random positions against memmove on a plain buffer, with
+// searches for needles that span the pieces the edits leave behind
+//
+//   cc -std=gnu11 -I.. rope.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define MAX (1 << 16)
+
+static char model[MAX];
+static size_t size;
+
+static size_t naive_find(const char * needle, size_t len, size_t pos)
+{
+    if(len == 0)
+        return npos;
+    for(size_t i = pos; i + len <= size; i++)
+        if(memcmp(model + i, needle, len) == 0)
+            return i;
+    return npos;
+}
+
+struct joined { char * buf; size_t len; };
+
+static bool join(void * ctx, const char * piece, size_t len)
+{
+    struct joined * j = ctx;
+    memcpy(j->buf + j->len, piece, len);
+    j->len += len;
+    return true;
+}
+
+int main(void)
+{
+    static char buf[MAX];
+    cstr_rope rope = cstr_rope_new(NULL);
+
+    for(int i = 0; i < 50000; i++)
+    {
+        size_t pos = rnd() % (size + 1), len = rnd() % 100;
+
+        if(size + len < MAX && rnd() % 3)
+        {
+            char text[100];
+            for(size_t k = 0; k < len; k++)
+                text[k] = 'a' + rnd() % 3;
+            memmove(model + pos + len, model + pos, size - pos);
+            memcpy(model + pos, text, len);
+            size += len;
+            cstr_rope_insert_n(rope, pos, text, len);
+        }
+        else
+        {
+            size_t n = pos < size ? (len > size - pos ? size - pos : len) : 0;
+            memmove(model + pos, model + pos + n, size - pos - n);
+            size -= n;
+            cstr_rope_erase(rope, pos, len);
+        }
+
+        CHECK(cstr_rope_length(rope) == size);
+        CHECK(cstr_rope_at(rope, pos) == (pos < size ? model[pos] : '\0'));
+
+        if(i % 50 == 0)
+        {
+            // needles taken from the text usually cross a piece boundary
+            size_t nl = 1 + rnd() % 12, from = size > nl ? rnd() % (size - nl) : 0;
+            const char * needle = size > nl ? model + from : "abc";
+            nl = size > nl ? nl : 3;
+            char copy[12];
+            memcpy(copy, needle, nl);
+
+            size_t next = rnd() % (size + 1), start = next;
+            CHECK(cstr_rope_find_n(rope, copy, nl, &next) == naive_find(copy, nl, start));
+
+            char * sub = cstr_rope_substr(rope, pos, len);
+            if(pos < size)
+            {
+                size_t n = len > size - pos ? size - pos : len;
+                CHECK(sub != NULL && memcmp(sub, model + pos, n) == 0 && sub[n] == '\0');
+            }
+            free(sub);
+
+            struct joined j = { buf, 0 };
+            cstr_rope_each(rope, &join, &j);
+            CHECK(j.len == size && memcmp(buf, model, size) == 0);
+        }
+
+        // joining the pieces must not disturb later edits
+        if(i % 5000 == 0)
+            CHECK(memcmp(cstr_rope_data(rope), model, size) == 0);
+    }
+
+    CHECK(memcmp(cstr_rope_data(rope), model, size) == 0 && cstr_rope_data(rope)[size] == '\0');
+    cstr_rope_delete(rope);
+    return done();
+}
@@ -0,0 +1,183 @@
+// Copy on write sharing: the single threaded detach rules, swaps between
+// strings from different allocators, then eight threads sharing, modifying
+// and releasing one heap buffer while it stays intact. Meant to be run under
+// ThreadSanitizer as well
+//
+//   cc -std=gnu11 -fsanitize=thread -I.. share_threads.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define THREADS 8
+#define ROUNDS  2000
+
+static cstring * base;
+static char expect[1000];
+static atomic_int failures;
+
+#define CHECK(cond) do { if(!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+                                       atomic_fetch_add(&failures, 1); } } while(0)
+
+// hooks that count the bytes each context has out, so a block or cstring
+// freed through the wrong allocator leaves one count high and one low
+static void * count_alloc(void * ctx, size_t size)
+{
+    *(long *)ctx += (long)size;
+    return malloc(size);
+}
+
+static void * count_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    *(long *)ctx += (long)new_size - (long)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void count_free(void * ctx, void * ptr, size_t size)
+{
+    *(long *)ctx -= (long)size;
+    free(ptr);
+}
+
+// swaps every pairing of inline and heap strings from two allocators and
+// checks the contents against the strings they were made from
+static void swap_across(const cstr_allocator * x, const cstr_allocator * y)
+{
+    const char * texts[] = { "short", "a string too long to be stored inline in the cstring" };
+
+    for(int i = 0; i < 4; i++)
+    {
+        const char * tx = texts[i & 1], * ty = texts[i >> 1];
+        cstring * a = string_alloc(tx, strlen(tx), x);
+        cstring * b = string_alloc(ty, strlen(ty), y);
+
+        cstr_swap(a, b);
+        CHECK(cstr_compare(a, ty) && cstr_compare(b, tx));
+
+        // both must still grow and be freed through their own allocator
+        cstr_append(a, " and more text to move it to the heap");
+        cstr_append(b, "!");
+        CHECK(cstr_length(a) == strlen(ty) + 37 && cstr_length(b) == strlen(tx) + 1);
+
+        delete_string(a);
+        delete_string(b);
+    }
+}
+
+static void * work(void * arg)
+{
+    (void)arg;
+
+    for(int i = 0; i < ROUNDS; i++)
+    {
+        cstring * s = string_share(base);
+        CHECK(cstr_data(s) == cstr_data(base));
+        CHECK(cstr_hash(s) == cstr_view_hash(cstr_view_n(expect, 999)));
+
+        if(i % 3 == 0)
+        {
+            cstr_append(s, "x");
+            CHECK(cstr_data(s) != cstr_data(base) && cstr_length(s) == 1000);
+        }
+        else if(i % 3 == 1)
+        {
+            cstr_erase(s, 0, 5);
+            CHECK(cstr_length(s) == 994 && memcmp(cstr_data(s), expect + 5, 994) == 0);
+        }
+
+        delete_string(s);
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    memset(expect, 'q', 999);
+    base = string(expect);
+
+    // every modifier detaches a shared string and leaves the others alone
+    cstring * a = string_share(base);
+    CHECK(cstr_data(a) == cstr_data(base));
+    cstr_push_back(a, 'z');
+    CHECK(cstr_length(a) == 1000 && cstr_length(base) == 999 && cstr_data(a) != cstr_data(base));
+
+    cstring * b = string_share(base);
+    cstr_pop_back(b);
+    CHECK(cstr_length(b) == 998 && cstr_length(base) == 999);
+
+    cstring * c = string_share(base);
+    cstr_clear(c);
+    CHECK(cstr_length(c) == 0 && cstr_length(base) == 999);
+
+    cstring * d = string_share(base);
+    cstr_insert_n(d, 0, cstr_data(d), 10);
+    CHECK(cstr_length(d) == 1009 && cstr_length(base) == 999);
+
+    // sharing an inline string copies it
+    cstring * e = string("tiny");
+    cstring * f = string_share(e);
+    cstr_append(f, "!");
+    CHECK(strcmp(cstr_data(e), "tiny") == 0 && strcmp(cstr_data(f), "tiny!") == 0);
+
+    // the last owner may modify in place again
+    cstring * g = string("short");
+    cstr_share(g, base);
+    CHECK(cstr_data(g) == cstr_data(base));
+
+    // swaps between allocators, including arena and malloc inline strings
+    long out_1 = 0, out_2 = 0;
+    const cstr_allocator c1 = { &count_alloc, &count_realloc, &count_free, &out_1 };
+    const cstr_allocator c2 = { &count_alloc, &count_realloc, &count_free, &out_2 };
+    swap_across(&c1, &c2);
+    swap_across(&c1, NULL);
+    swap_across(NULL, &c2);
+    CHECK(out_1 == 0 && out_2 == 0);
+
+    cstr_arena arena = cstr_arena_new(0);
+    swap_across(cstr_arena_allocator(arena), NULL);
+    swap_across(NULL, cstr_arena_allocator(arena));
+    swap_across(cstr_arena_allocator(arena), &c1);
+    CHECK(out_1 == 0);
+    cstr_arena_delete(arena);
+
+    // a mapped string swapped with an ordinary one takes its marker along
+    cstring * mapped = string_map(__FILE__);
+    if(mapped != NULL)
+    {
+        size_t len = cstr_length(mapped);
+        cstring * plain = string("plain");
+        cstr_swap(plain, mapped);
+        CHECK(cstr_length(plain) == len && cstr_compare(mapped, "plain"));
+        cstr_append(mapped, "!");
+        cstr_push_back(plain, '!');
+        CHECK(cstr_length(plain) == len + 1 && cstr_compare(mapped, "plain!"));
+        delete_string(plain);
+        delete_string(mapped);
+    }
+
+    pthread_t t[THREADS];
+    for(int i = 0; i < THREADS; i++)
+        pthread_create(&t[i], NULL, &work, NULL);
+    for(int i = 0; i < THREADS; i++)
+        pthread_join(t[i], NULL);
+
+    CHECK(cstr_length(base) == 999 && memcmp(cstr_data(base), expect, 999) == 0);
+
+    delete_string(base);
+    CHECK(cstr_length(g) == 999);
+    cstr_append(g, "!");
+    CHECK(cstr_length(g) == 1000);
+
+    delete_string(a);
+    delete_string(b);
+    delete_string(c);
+    delete_string(d);
+    delete_string(e);
+    delete_string(f);
+    delete_string(g);
+
+    printf(failures ? "FAILED\n" : "ok\n");
+    return failures != 0;
+}
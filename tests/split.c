@@ -0,0 +1,128 @@
+// Splitting on a character, a set and a string against a naive tokenizer
+// that tests every position for a delimiter, with limits and collapsing
+//
+//   cc -std=gnu11 -I.. split.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+#define MAXTOK 1100
+
+static const char * hay;
+static size_t n;
+static const char * set;    // delimiter characters, or NULL for the string
+static const char * delim;
+static size_t dl;
+
+// the length of the delimiter at i, 0 if there is none
+static size_t delim_at(size_t i)
+{
+    if(set != NULL)
+        return i < n && memchr(set, hay[i], strlen(set)) != NULL;
+    return dl > 0 && i + dl <= n && memcmp(hay + i, delim, dl) == 0 ? dl : 0;
+}
+
+static size_t naive_split(size_t max, bool collapse, cstr_token * out)
+{
+    size_t count = 0, pos = 0;
+    for(;;)
+    {
+        size_t start = pos, end = start;
+        if(collapse)
+            while(start < n && delim_at(start))
+                start += delim_at(start);
+
+        // the last allowed token is the rest
+        end = start;
+        if(max == 0 || count + 1 < max)
+            while(end < n && !delim_at(end))
+                end++;
+        else
+            end = n;
+
+        if(end >= n)
+        {
+            if(!(collapse && start >= n))
+            {
+                out[count].pos = start;
+                out[count++].len = n - start;
+            }
+            return count;
+        }
+
+        out[count].pos = start;
+        out[count++].len = end - start;
+        pos = end + delim_at(end);
+    }
+}
+
+int main(void)
+{
+    static cstr_token want[MAXTOK], got[MAXTOK];
+    char buf[1000];
+
+    for(int i = 0; i < 30000; i++)
+    {
+        n = rnd() % (i % 4 ? 80 : sizeof(buf));
+        for(size_t k = 0; k < n; k++)
+            buf[k] = "ab,; "[rnd() % (2 + rnd() % 4)];
+        hay = buf;
+
+        size_t max = rnd() % 3 ? 0 : rnd() % 6;
+        bool collapse = rnd() % 2;
+        cstr_view v = cstr_view_n(buf, n);
+        cstr_split it;
+
+        int kind = rnd() % 3;
+        if(kind == 0)
+        {
+            char c = ",; "[rnd() % 3];
+            char one[2] = { c, '\0' };
+            set = one;
+            it = cstr_split_on_char(v, c, max, collapse);
+            size_t count = naive_split(max, collapse, want);
+            set = NULL;
+            CHECK(cstr_split_all(&it, got, MAXTOK) == count && memcmp(got, want, count * sizeof(cstr_token)) == 0);
+            continue;
+        }
+
+        if(kind == 1)
+        {
+            set = rnd() % 2 ? ",;" : ", ";
+            cstr_charset cs = cstr_charset_of(set);
+            it = cstr_split_on(v, &cs, max, collapse);
+            size_t count = naive_split(max, collapse, want);
+            CHECK(cstr_split_all(&it, got, MAXTOK) == count && memcmp(got, want, count * sizeof(cstr_token)) == 0);
+
+            // the member gives the same tokens on a cstring
+            if(max > 0)
+            {
+                cstring * s = string_n(buf, n);
+                CHECK(cstr_split_into(s, &cs, got, max, collapse) == count);
+                CHECK(memcmp(got, want, count * sizeof(cstr_token)) == 0);
+                delete_string(s);
+            }
+            set = NULL;
+            continue;
+        }
+
+        const char * delims[] = { ",", ";,", "ab", "a,b", "" };
+        delim = delims[rnd() % 5];
+        dl = strlen(delim);
+        it = cstr_split_on_str(v, cstr_view_n(delim, dl), max, collapse);
+        size_t count = naive_split(max, collapse, want);
+
+        // one token at a time this time
+        cstr_token tok;
+        size_t k = 0;
+        while(cstr_split_next(&it, &tok))
+        {
+            CHECK(k < count && tok.pos == want[k].pos && tok.len == want[k].len);
+            CHECK(k >= count || cstr_view_compare(cstr_token_view(v, tok), cstr_view_n(buf + want[k].pos, want[k].len)));
+            k++;
+        }
+        CHECK(k == count);
+    }
+
+    return done();
+}
@@ -0,0 +1,103 @@
+// Short strings live inside the cstring and need no allocation of their own,
+// and every member behaves the same on either side of the boundary, checked
+// against plain char buffers
+//
+//   cc -std=gnu11 -I.. sso.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static int blocks;
+
+static void * count_alloc(void * ctx, size_t size)
+{
+    (void)ctx;
+    blocks++;
+    return malloc(size);
+}
+
+static void * count_realloc(void * ctx, void * ptr, size_t old_size, size_t new_size)
+{
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void count_free(void * ctx, void * ptr, size_t size)
+{
+    (void)ctx;
+    (void)size;
+    blocks--;
+    free(ptr);
+}
+
+static const cstr_allocator counted = { &count_alloc, &count_realloc, &count_free, NULL };
+
+static bool inside(cstring * s)
+{
+    const char * p = cstr_data(s);
+    return p > (const char *)s && p < (const char *)s + sizeof(cstring);
+}
+
+static size_t naive_find(const char * h, size_t n, const char * needle, size_t len)
+{
+    for(size_t i = 0; i + len <= n; i++)
+        if(memcmp(h + i, needle, len) == 0)
+            return i;
+    return npos;
+}
+
+int main(void)
+{
+    char src[64];
+    for(size_t k = 0; k < sizeof(src); k++)
+        src[k] = 'a' + rnd() % 3;
+
+    for(size_t len = 0; len < 48; len++)
+    {
+        cstring * s = string_alloc(src, len, &counted);
+        CHECK(blocks == (len <= 23 ? 1 : 2));
+        CHECK(inside(s) == (len <= 23));
+        CHECK(cstr_length(s) == len && memcmp(cstr_data(s), src, len) == 0 && cstr_data(s)[len] == '\0');
+
+        // the same answers from both representations
+        for(size_t n = 1; n < 4; n++)
+            for(size_t from = 0; from + n <= sizeof(src); from += 7)
+            {
+                size_t next = 0;
+                CHECK(cstr_find_n(s, src + from, n, &next) == naive_find(src, len, src + from, n));
+            }
+        CHECK(cstr_compare_n(s, src, len) && !cstr_compare_n(s, src, len + 1));
+        CHECK(len == 0 || (cstr_front(s) == src[0] && cstr_back(s) == src[len - 1]));
+        CHECK(cstr_view_hash(cstr_view_n(src, len)) == cstr_hash(s));
+
+        // an empty string gives a static "" rather than a copy
+        if(len > 0)
+        {
+            char * sub = (char *)cstr_substr(s, len / 3, len / 2);
+            CHECK(sub != NULL && memcmp(sub, src + len / 3, len / 2) == 0 && sub[len / 2] == '\0');
+            free(sub);
+        }
+
+        // growing one character at a time spills to the heap exactly past 23
+        for(size_t n = len; n < 30; n++)
+        {
+            cstr_push_back(s, src[n]);
+            CHECK(inside(s) == (n < 23 && len <= 23));
+            CHECK(cstr_length(s) == n + 1 && memcmp(cstr_data(s), src, n + 1) == 0);
+        }
+
+        // swapping a short string with a long one moves each to the other side
+        cstring * t = string_alloc(src, len / 2, &counted);
+        cstr_swap(s, t);
+        CHECK(cstr_length(t) == (len < 30 ? 30 : len) && memcmp(cstr_data(t), src, cstr_length(t)) == 0);
+        CHECK(cstr_length(s) == len / 2 && memcmp(cstr_data(s), src, len / 2) == 0);
+        CHECK(inside(s) == (len / 2 <= 23));
+
+        delete_string(s);
+        delete_string(t);
+        CHECK(blocks == 0);
+    }
+
+    return done();
+}
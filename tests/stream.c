@@ -0,0 +1,104 @@
+// Streaming search over a pipe fed in uneven pieces and over a FILE, against
+// a naive non-overlapping search of the whole input held in memory, with
+// chunks down to a single byte so that occurrences straddle every boundary
+//
+//   cc -std=gnu11 -I.. stream.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAX 20000
+
+static char input[MAX];
+static size_t size;
+static int pipe_fd[2];
+static unsigned pieces;
+
+// writes the input into the pipe in pieces of varying size
+static void * feed(void * arg)
+{
+    (void)arg;
+    unsigned long long r = pieces;
+    for(size_t at = 0; at < size; )
+    {
+        r = r * 6364136223846793005ull + 1442695040888963407ull;
+        size_t n = 1 + (r >> 33) % 700;
+        n = n > size - at ? size - at : n;
+        if(write(pipe_fd[1], input + at, n) != (ssize_t)n)
+            break;
+        at += n;
+    }
+    close(pipe_fd[1]);
+    return NULL;
+}
+
+static size_t naive_all(const char * needle, size_t len, uint64_t * out)
+{
+    size_t count = 0;
+    for(size_t i = 0; i + len <= size; )
+        if(memcmp(input + i, needle, len) == 0)
+        {
+            out[count++] = i;
+            i += len;
+        }
+        else
+            i++;
+    return count;
+}
+
+static void check_stream(cstr_stream s, const uint64_t * want, size_t count)
+{
+    uint64_t offset;
+    size_t k = 0;
+    while(cstr_stream_next(s, &offset))
+    {
+        CHECK(k < count && offset == want[k]);
+        k++;
+    }
+    CHECK(k == count && !cstr_stream_error(s));
+    cstr_stream_delete(s);
+}
+
+int main(void)
+{
+    static uint64_t want[MAX];
+
+    for(int i = 0; i < 300; i++)
+    {
+        size = rnd() % MAX;
+        size_t unit = 1 + rnd() % 4;
+        for(size_t k = 0; k < size; k++)
+            input[k] = rnd() % 30 ? 'a' + (k % unit) % 2 : 'c';
+
+        char needle[64];
+        size_t len = 1 + rnd() % (i % 2 ? 6 : 60);
+        for(size_t k = 0; k < len; k++)
+            needle[k] = 'a' + (k % unit) % 2;
+
+        cstr_pattern pat = cstr_pattern_n(needle, len);
+        size_t count = naive_all(needle, len, want);
+        size_t chunk = i % 3 ? 1 + rnd() % 100 : 0;
+
+        // a pipe, where reads return whatever has been written so far
+        pthread_t t;
+        CHECK(pipe(pipe_fd) == 0);
+        pieces = rnd();
+        pthread_create(&t, NULL, &feed, NULL);
+        check_stream(cstr_stream_fd(pipe_fd[0], pat, chunk), want, count);
+        pthread_join(t, NULL);
+        close(pipe_fd[0]);
+
+        // a FILE
+        FILE * f = tmpfile();
+        fwrite(input, 1, size, f);
+        rewind(f);
+        check_stream(cstr_stream_file(f, pat, chunk), want, count);
+        fclose(f);
+
+        cstr_pattern_delete(pat);
+    }
+
+    return done();
+}
@@ -0,0 +1,81 @@
+// Views of cstrings and of plain buffers against the same operations done
+// with string.h, and the cstring members that take them
+//
+//   cc -std=gnu11 -I.. views.c ../cstring.c -lm -pthread && ./a.out
+
+#include "cstring.h"
+#include "check.h"
+
+static size_t naive_find(const char * h, size_t n, const char * needle, size_t len, size_t pos)
+{
+    if(len == 0)
+        return npos;
+    for(size_t i = pos; i + len <= n; i++)
+        if(memcmp(h + i, needle, len) == 0)
+            return i;
+    return npos;
+}
+
+int main(void)
+{
+    char buf[300];
+
+    for(int i = 0; i < 20000; i++)
+    {
+        size_t n = rnd() % sizeof(buf);
+        for(size_t k = 0; k < n; k++)
+            buf[k] = 'a' + rnd() % 3;
+
+        cstring * s = string_n(buf, n);
+        cstr_view v = cstr_view_of(s);
+        CHECK(v.ptr == cstr_data(s) && v.len == n);
+
+        // substr and subview clamp alike, the view pointing into the string
+        size_t pos = rnd() % (n + 3), len = rnd() % (n + 3);
+        size_t want_pos = pos > n ? n : pos, want_len = len > n - want_pos ? n - want_pos : len;
+        cstr_view sub = cstr_subview(s, pos, len);
+        CHECK(sub.ptr == cstr_data(s) + want_pos && sub.len == want_len);
+        CHECK(cstr_view_compare(cstr_view_substr(cstr_view_n(buf, n), pos, len), cstr_view_n(buf + want_pos, want_len)));
+
+        // find on a view, from every kind of start
+        cstr_view needle = cstr_view_n(buf + rnd() % (n + 1), rnd() % 5);
+        if(needle.ptr + needle.len > buf + n)
+            needle.len = buf + n - needle.ptr;
+        size_t from = rnd() % (n + 2);
+        CHECK(cstr_view_find(v, needle, from) == naive_find(buf, n, needle.ptr, needle.len, from));
+
+        size_t next = from;
+        size_t at = n == 0 ? npos : naive_find(buf, n, needle.ptr, needle.len, from);
+        CHECK(cstr_find_view(s, needle, &next) == at);
+
+        CHECK(cstr_view_starts_with(v, sub) == (sub.len <= n && memcmp(buf, sub.ptr, sub.len) == 0));
+        CHECK(cstr_view_ends_with(v, sub) == (sub.len <= n && memcmp(buf + n - sub.len, sub.ptr, sub.len) == 0));
+        CHECK(cstr_compare_view(s, cstr_view_n(buf, n)) && (n == 0 || !cstr_compare_view(s, cstr_view_n(buf, n - 1))));
+        CHECK(cstr_view_hash(v) == cstr_view_hash(cstr_view_n(buf, n)));
+
+        // the members that read from a view, including one into the string itself
+        char model[1000];
+        memcpy(model, buf, n);
+        memcpy(model + n, sub.ptr, sub.len);
+        cstr_append_view(s, sub);
+        CHECK(cstr_length(s) == n + sub.len && memcmp(cstr_data(s), model, n + sub.len) == 0);
+
+        size_t at_pos = rnd() % (n + 1);
+        cstr_view part = cstr_subview(s, 0, 7);
+        char piece[7];
+        memcpy(piece, part.ptr, part.len);
+        memmove(model + at_pos + part.len, model + at_pos, n + sub.len - at_pos);
+        memcpy(model + at_pos, piece, part.len);
+        cstr_insert_view(s, at_pos, part);
+        CHECK(cstr_length(s) == n + sub.len + part.len && memcmp(cstr_data(s), model, cstr_length(s)) == 0);
+
+        size_t total = cstr_length(s), rest = total > 1 ? total - 1 : 0;
+        cstr_assign_view(s, cstr_subview(s, 1, 5));
+        CHECK(cstr_length(s) == (rest < 5 ? rest : 5) && memcmp(cstr_data(s), model + 1, cstr_length(s)) == 0);
+
+        delete_string(s);
+    }
+
+    CHECK(cstr_view_from(NULL).len == 0 && cstr_view_from("abc").len == 3);
+    return done();
+}